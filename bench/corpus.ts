@@ -0,0 +1,194 @@
+/**
+ * Synthetic corpora and a fake embedding server for Tieto's benchmarks.
+ *
+ * Nothing here needs a model. Vectors are drawn around a fixed set of
+ * cluster centres, so a question lands near some chunks and far from most,
+ * the way real embeddings do. The same (count, dim, seed) always produces
+ * the same corpus, and the fake server always gives the same text the same
+ * vector, so runs can be compared.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { computeNorms } from "../src/kernels.ts";
+import { DocTable, Segment, writeSegment } from "../src/store.ts";
+import { lcg } from "../src/ivf.ts";
+
+// rows per segment file in a generated topic (roughly one big document)
+const ROWS_PER_SEGMENT = 10_000;
+const CLUSTERS = 64;
+const STATUSES = ["current", "draft", "old"];
+
+// a cheap normal sample
+function gaussian(rand: () => number): number {
+  return rand() + rand() + rand() + rand() - 2;
+}
+
+// FNV-1a, to turn a text into a seed
+function hash(text: string): number {
+  let h = 0x811c9dc5;
+  for (let i = 0; i < text.length; i++) {
+    h = Math.imul(h ^ text.charCodeAt(i), 0x01000193);
+  }
+  return h >>> 0;
+}
+
+// "1k" / "10k" / "1m" / "2500" → number
+export function parseSize(size: string): number {
+  const m = size.trim().toLowerCase().match(/^(\d+(?:\.\d+)?)([km]?)$/);
+  if (!m) throw new Error(`Bad corpus size: '${size}'`);
+  return Math.round(Number(m[1]) * (m[2] === "m" ? 1e6 : m[2] === "k" ? 1e3 : 1));
+}
+
+export function formatSize(n: number): string {
+  if (n >= 1e6 && n % 1e6 === 0) return `${n / 1e6}m`;
+  if (n >= 1e3 && n % 1e3 === 0) return `${n / 1e3}k`;
+  return `${n}`;
+}
+
+// comma-separated list from the environment, e.g. TIETO_BENCH_SIZES=1k,10k
+export function envList(name: string, fallback: string): string[] {
+  return (Deno.env.get(name) || fallback).split(",").map((s) => s.trim()).filter(Boolean);
+}
+
+export class VectorSpace {
+  readonly dim: number;
+  private centres: Float32Array;
+
+  constructor(dim: number, seed = 1) {
+    this.dim = dim;
+    const rand = lcg(seed);
+    this.centres = new Float32Array(CLUSTERS * dim);
+    for (let i = 0; i < this.centres.length; i++) this.centres[i] = gaussian(rand);
+  }
+
+  // one row near cluster `c`, written into out[offset..]
+  fill(out: Float32Array, offset: number, c: number, rand: () => number): void {
+    const centre = (c % CLUSTERS) * this.dim;
+    for (let d = 0; d < this.dim; d++) {
+      out[offset + d] = this.centres[centre + d] + 0.6 * gaussian(rand);
+    }
+  }
+
+  // the vector the fake embedding server returns for `text`
+  embed(text: string): Float32Array {
+    const seed = hash(text);
+    const out = new Float32Array(this.dim);
+    this.fill(out, 0, seed, lcg(seed));
+    return out;
+  }
+}
+
+// `count` rows near random clusters, with chunk text and frontmatter
+export function generateSegment(
+  space: VectorSpace,
+  count: number,
+  seed: number,
+  doc: string,
+): Segment {
+  const { dim } = space;
+  const rand = lcg(seed);
+  const vectors = new Float32Array(count * dim);
+  const texts: string[] = new Array(count);
+  const table = new DocTable();
+  const docOf = new Uint32Array(count);
+  for (let r = 0; r < count; r++) {
+    space.fill(vectors, r * dim, Math.floor(rand() * CLUSTERS), rand);
+    texts[r] = `${doc} chunk ${r}: synthetic text for benchmarking.`;
+    docOf[r] = table.add({
+      title: doc,
+      status: STATUSES[r % STATUSES.length],
+      prio: r % 10,
+      updated: `2025-${String(1 + (r % 12)).padStart(2, "0")}-01`,
+    });
+  }
+  return {
+    dim,
+    count,
+    vectors,
+    norms: computeNorms(vectors, dim, count),
+    texts,
+    docs: table.docs,
+    docOf,
+  };
+}
+
+// Write a topic of `count` chunks under {topicsDir}/{topic}/memory, in
+// segments of ROWS_PER_SEGMENT rows
+export async function writeTopic(
+  topicsDir: string,
+  topic: string,
+  space: VectorSpace,
+  count: number,
+): Promise<void> {
+  const memDir = join(topicsDir, topic, "memory");
+  await Deno.mkdir(memDir, { recursive: true });
+  for (let s = 0, done = 0; done < count; s++) {
+    const rows = Math.min(ROWS_PER_SEGMENT, count - done);
+    const doc = `doc-${s}`;
+    await writeSegment(join(memDir, doc), generateSegment(space, rows, s + 1, doc));
+    done += rows;
+  }
+}
+
+// Documents for ingest benchmarks: `docs` files of `lines` lines each,
+// with frontmatter, directly in {topicsDir}/{topic}
+export async function writeDocuments(
+  topicsDir: string,
+  topic: string,
+  docs: number,
+  lines: number,
+): Promise<void> {
+  const dir = join(topicsDir, topic);
+  await Deno.mkdir(dir, { recursive: true });
+  for (let d = 0; d < docs; d++) {
+    const body = Array.from({ length: lines }, (_, l) =>
+      `Line ${l} of document ${d} talks about widget ${(d * 31 + l) % 97} and its price.`);
+    await Deno.writeTextFile(
+      join(dir, `doc-${d}.md`),
+      `---\ntitle: doc-${d}\nstatus: ${STATUSES[d % STATUSES.length]}\n---\n${body.join("\n")}\n`,
+    );
+  }
+}
+
+// questions that land near the corpus clusters
+export function questions(n: number): string[] {
+  return Array.from({ length: n }, (_, i) => `benchmark question ${i}`);
+}
+
+export interface MockEmbedder {
+  url: string;
+  // inputs embedded so far
+  readonly inputs: number;
+  close(): Promise<void>;
+}
+
+// An OpenAI-compatible /v1/embeddings server on a free local port.
+// `latencyMs` is added to every request, to stand in for the model.
+export function startMockEmbedder(space: VectorSpace, latencyMs = 0): MockEmbedder {
+  let inputs = 0;
+  const server = Deno.serve({ port: 0, hostname: "127.0.0.1", onListen() {} }, async (req) => {
+    const { input } = await req.json();
+    const texts: string[] = Array.isArray(input) ? input : [input];
+    inputs += texts.length;
+    if (latencyMs) await new Promise((r) => setTimeout(r, latencyMs));
+    const data = texts.map((text, index) => ({ index, embedding: Array.from(space.embed(text)) }));
+    return Response.json({ data });
+  });
+  const { port } = server.addr as Deno.NetAddr;
+  return {
+    url: `http://127.0.0.1:${port}/v1/embeddings`,
+    get inputs() {
+      return inputs;
+    },
+    close: () => server.shutdown(),
+  };
+}
+
+// value at quantile `p` (0..1) of already-sorted samples
+export function percentile(sorted: number[], p: number): number {
+  if (!sorted.length) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+}
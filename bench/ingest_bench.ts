@@ -0,0 +1,43 @@
+/**
+ * `deno bench -A bench/` — ingest throughput against a mocked embedding
+ * server, so what's measured is Tieto's side of it: reading, chunking,
+ * hashing, batching and writing segments.
+ *
+ * TIETO_BENCH_DIMS picks the dimensions (default "384,768,1024").
+ * TIETO_BENCH_EMBED_MS adds latency to every embedding request (default
+ * 0), to see how well batching and ingestConcurrency hide a slow model.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { Tieto } from "../src/tieto.class.ts";
+import { envList, startMockEmbedder, VectorSpace, writeDocuments } from "./corpus.ts";
+
+const DIMS = envList("TIETO_BENCH_DIMS", "384,768,1024").map(Number);
+const LATENCY = Number(Deno.env.get("TIETO_BENCH_EMBED_MS") ?? 0);
+// 50 documents of 60 lines, about 5 chunks each at the default chunkSize
+const DOCS = 50;
+const LINES = 60;
+
+const topicsDir = await Deno.makeTempDir({ prefix: "tieto-bench-" });
+await writeDocuments(topicsDir, "ingest", DOCS, LINES);
+
+for (const dim of DIMS) {
+  const embedder = startMockEmbedder(new VectorSpace(dim), LATENCY);
+  const tieto = new Tieto({ topicsDirectory: topicsDir, embeddingUrl: embedder.url });
+
+  Deno.bench(`ingestTopic ${DOCS} docs x ${dim}`, { group: "ingest" }, async (b) => {
+    // unchanged chunks are never re-embedded, so start from nothing
+    await Deno.remove(join(topicsDir, "ingest", "memory"), { recursive: true })
+      .catch(() => {});
+    b.start();
+    await tieto.ingestTopic("ingest");
+    b.end();
+  });
+}
+
+addEventListener("unload", () => {
+  Deno.removeSync(topicsDir, { recursive: true });
+});
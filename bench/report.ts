@@ -0,0 +1,215 @@
+#!/usr/bin/env -S deno run -A
+
+/**
+ * Benchmark report for Tieto: query latency (p50 / p99), cold load time,
+ * peak RSS and chunks per second over synthetic corpora, compared against
+ * bench/baseline.json.
+ *
+ *   deno run -A bench/report.ts              run and compare with the baseline
+ *   deno run -A bench/report.ts --update     run and record a new baseline
+ *
+ * Options: --sizes 1k,10k,100k (add 1m for the big one, it needs ~4 GiB at
+ * 1024 dims), --dims 384,768,1024, --queries 200, --tolerance 0.25.
+ *
+ * Every case runs in its own process, so one case's heap doesn't inflate
+ * the next one's RSS. A case regresses when a time or RSS grows, or a
+ * throughput drops, by more than the tolerance; the report then exits 1.
+ * Baselines only mean something on the machine (and runtime) they were
+ * recorded on, so none ships with the repo: record one with --update
+ * before the first comparison, and again after changing hardware. Without
+ * one the report fails rather than passing with nothing to compare.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { fromFileUrl, join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { Tieto } from "../src/tieto.class.ts";
+import {
+  formatSize,
+  parseSize,
+  percentile,
+  questions,
+  startMockEmbedder,
+  VectorSpace,
+  writeDocuments,
+  writeTopic,
+} from "./corpus.ts";
+
+const BASELINE = new URL("./baseline.json", import.meta.url);
+const INGEST_DOCS = 50;
+const INGEST_LINES = 60;
+
+// one measured case; times in ms, RSS in MiB
+type Result = Record<string, number>;
+
+interface Report {
+  recorded: string;
+  runtime: string;
+  cpus: number;
+  cases: Record<string, Result>;
+}
+
+// which way is worse for each metric
+const LOWER_IS_BETTER = new Set(["p50Ms", "p99Ms", "loadMs", "ms", "rssMb"]);
+
+function option(name: string, fallback: string): string {
+  const at = Deno.args.indexOf(`--${name}`);
+  return at >= 0 && Deno.args[at + 1] ? Deno.args[at + 1] : fallback;
+}
+
+const rssMb = () => Deno.memoryUsage().rss / (1024 * 1024);
+const round = (n: number) => Math.round(n * 100) / 100;
+
+async function searchCase(size: number, dim: number, queries: number): Promise<Result> {
+  const topicsDir = await Deno.makeTempDir({ prefix: "tieto-bench-" });
+  const space = new VectorSpace(dim);
+  const embedder = startMockEmbedder(space);
+  try {
+    await writeTopic(topicsDir, "bench", space, size);
+    const tieto = new Tieto({
+      topicsDirectory: topicsDir,
+      embeddingUrl: embedder.url,
+      minSimilarityThreshold: -1,
+      maxDistance: Infinity,
+      maxResults: 10,
+      embeddingCacheSize: queries,
+    });
+
+    let start = performance.now();
+    await tieto.warm("bench");
+    const loadMs = performance.now() - start;
+    let peak = rssMb();
+
+    // the first round fills the embedding cache (and warms up the JIT);
+    // the second is what gets measured
+    const asked = questions(queries);
+    for (const q of asked) await tieto.search("bench", q);
+    const times: number[] = [];
+    for (const q of asked) {
+      start = performance.now();
+      await tieto.search("bench", q);
+      times.push(performance.now() - start);
+      peak = Math.max(peak, rssMb());
+    }
+    tieto.close();
+
+    times.sort((a, b) => a - b);
+    const mean = times.reduce((s, t) => s + t, 0) / times.length;
+    return {
+      p50Ms: round(percentile(times, 0.5)),
+      p99Ms: round(percentile(times, 0.99)),
+      loadMs: round(loadMs),
+      rssMb: round(peak),
+      chunksPerSec: Math.round(size / (mean / 1000)),
+    };
+  } finally {
+    await embedder.close();
+    await Deno.remove(topicsDir, { recursive: true });
+  }
+}
+
+async function ingestCase(dim: number): Promise<Result> {
+  const topicsDir = await Deno.makeTempDir({ prefix: "tieto-bench-" });
+  const embedder = startMockEmbedder(new VectorSpace(dim));
+  try {
+    await writeDocuments(topicsDir, "ingest", INGEST_DOCS, INGEST_LINES);
+    const tieto = new Tieto({ topicsDirectory: topicsDir, embeddingUrl: embedder.url });
+    const start = performance.now();
+    await tieto.ingestTopic("ingest");
+    const ms = performance.now() - start;
+    return {
+      ms: round(ms),
+      rssMb: round(rssMb()),
+      chunksPerSec: Math.round(embedder.inputs / (ms / 1000)),
+    };
+  } finally {
+    await embedder.close();
+    await Deno.remove(topicsDir, { recursive: true });
+  }
+}
+
+// child process: run one case, print its result as JSON
+async function runCase(name: string, queries: number): Promise<Result> {
+  const [kind, size, , dim] = name.split(" ");
+  if (kind === "ingest") return ingestCase(Number(dim));
+  return searchCase(parseSize(size), Number(dim), queries);
+}
+
+async function spawnCase(name: string, queries: number): Promise<Result> {
+  const { code, stdout } = await new Deno.Command(Deno.execPath(), {
+    args: ["run", "-A", fromFileUrl(import.meta.url), "--case", name, "--queries", `${queries}`],
+    stdout: "piped",
+    stderr: "inherit",
+  }).output();
+  if (code !== 0) throw new Error(`Benchmark case '${name}' failed (exit ${code})`);
+  return JSON.parse(new TextDecoder().decode(stdout));
+}
+
+function compare(current: Report, baseline: Report | null, tolerance: number): string[] {
+  const regressions: string[] = [];
+  for (const [name, result] of Object.entries(current.cases)) {
+    const before = baseline?.cases[name];
+    const cells = Object.entries(result).map(([metric, value]) => {
+      const old = before?.[metric];
+      if (!old) return `${metric} ${value}`;
+      const change = (value - old) / old;
+      const worse = LOWER_IS_BETTER.has(metric) ? change : -change;
+      if (worse > tolerance) regressions.push(`${name}: ${metric} ${old} → ${value}`);
+      const sign = change >= 0 ? "+" : "";
+      return `${metric} ${value} (${sign}${Math.round(change * 100)}%)`;
+    });
+    console.log(`${name.padEnd(24)} ${cells.join("  ")}`);
+  }
+  return regressions;
+}
+
+if (import.meta.main) {
+  const queries = Number(option("queries", "200"));
+
+  const only = option("case", "");
+  if (only) {
+    console.log(JSON.stringify(await runCase(only, queries)));
+    Deno.exit(0);
+  }
+
+  const sizes = option("sizes", "1k,10k,100k").split(",").map(parseSize);
+  const dims = option("dims", "384,768,1024").split(",").map(Number);
+  const tolerance = Number(option("tolerance", "0.25"));
+  const update = Deno.args.includes("--update");
+
+  const names = [
+    ...dims.flatMap((dim) => sizes.map((size) => `search ${formatSize(size)} x ${dim}`)),
+    ...dims.map((dim) => `ingest ${INGEST_DOCS}docs x ${dim}`),
+  ];
+  const report: Report = {
+    recorded: new Date().toISOString(),
+    runtime: `deno ${Deno.version.deno}, v8 ${Deno.version.v8}`,
+    cpus: navigator.hardwareConcurrency,
+    cases: {},
+  };
+  for (const name of names) report.cases[name] = await spawnCase(name, queries);
+
+  const baseline: Report | null = await Deno.readTextFile(BASELINE)
+    .then(JSON.parse)
+    .catch(() => null);
+  if (baseline) console.log(`Compared with baseline from ${baseline.recorded} (${baseline.runtime})`);
+  const regressions = compare(report, baseline, tolerance);
+
+  if (update) {
+    // keep cases this run didn't cover (e.g. 1m, recorded separately)
+    report.cases = { ...baseline?.cases, ...report.cases };
+    await Deno.writeTextFile(BASELINE, JSON.stringify(report, null, 2) + "\n");
+    console.log(`Baseline written to ${join("bench", "baseline.json")}`);
+  } else if (!baseline) {
+    console.error(
+      `\nNo baseline to compare with: run with --update on this machine to record ` +
+        join("bench", "baseline.json"),
+    );
+    Deno.exit(1);
+  } else if (regressions.length) {
+    console.error(`\n${regressions.length} regression(s) beyond ${tolerance * 100}%:`);
+    for (const r of regressions) console.error(`  ${r}`);
+    Deno.exit(1);
+  }
+}
@@ -0,0 +1,139 @@
+/**
+ * `deno bench -A bench/` — micro and end-to-end benchmarks of the search
+ * hot paths: row scoring, filter evaluation, resident and batched search
+ * and cold topic loads.
+ *
+ * Corpus sizes and dimensions come from TIETO_BENCH_SIZES (default
+ * "1k,10k") and TIETO_BENCH_DIMS (default "384,768,1024"). Bigger corpora
+ * (100k, 1m) work too, but take a while to generate; bench/report.ts is the
+ * better tool for those.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { scoreRows } from "../src/kernels.ts";
+import { createSimdScorer } from "../src/simd.ts";
+import { compileFilters, FilterExpr } from "../src/filters.ts";
+import { MetaIndex } from "../src/metaindex.ts";
+import { Tieto } from "../src/tieto.class.ts";
+import {
+  envList,
+  formatSize,
+  generateSegment,
+  parseSize,
+  questions,
+  startMockEmbedder,
+  VectorSpace,
+  writeTopic,
+} from "./corpus.ts";
+
+const SIZES = envList("TIETO_BENCH_SIZES", "1k,10k").map(parseSize);
+const DIMS = envList("TIETO_BENCH_DIMS", "384,768,1024").map(Number);
+
+// leading dimensions scored by the Matryoshka coarse pass
+const PREFIX_DIMS = 128;
+
+const FILTERS: FilterExpr[] = [
+  { key: "status", op: "=", value: "current" },
+  { key: "prio", op: ">=", value: "5" },
+];
+
+const topicsDir = await Deno.makeTempDir({ prefix: "tieto-bench-" });
+const simd = createSimdScorer();
+// results go here, so the work can't be optimized away
+let sink = 0;
+
+for (const dim of DIMS) {
+  const space = new VectorSpace(dim);
+  const embedder = startMockEmbedder(space);
+  const asked = questions(64);
+
+  for (const size of SIZES) {
+    const label = `${formatSize(size)} x ${dim}`;
+    const topic = `bench-${size}-${dim}`;
+    await writeTopic(topicsDir, topic, space, size);
+
+    // scoring kernels over one contiguous matrix
+    const seg = generateSegment(space, size, 1, "score");
+    const q = space.embed(asked[0]);
+    const dots = new Float32Array(size);
+    const sqDists = new Float32Array(size);
+    Deno.bench(`scoreRows js ${label}`, { group: `score ${label}`, baseline: true }, () => {
+      scoreRows(seg.vectors!, dim, size, q, dots, sqDists);
+    });
+    if (simd) {
+      Deno.bench(`scoreRows simd ${label}`, { group: `score ${label}` }, () => {
+        simd(seg.vectors!, dim, size, q, dots, sqDists);
+      });
+    }
+
+    // filters: per-chunk predicate vs. the metadata index (dim doesn't
+    // matter here, so only once per size)
+    if (dim === DIMS[0]) {
+      const compiled = compileFilters(FILTERS);
+      const index = new MetaIndex(seg.docs, seg.docOf);
+      Deno.bench(`filter test ${formatSize(size)}`, { group: `filter ${formatSize(size)}`, baseline: true }, () => {
+        for (const doc of seg.docOf) if (compiled.test(seg.docs[doc])) sink++;
+      });
+      Deno.bench(`filter index ${formatSize(size)}`, { group: `filter ${formatSize(size)}` }, () => {
+        sink += index.select(compiled).length;
+      });
+    }
+
+    // search over a resident topic; question embeddings come from the
+    // cache after the first round, so this is the scan itself
+    const tieto = new Tieto({
+      topicsDirectory: topicsDir,
+      embeddingUrl: embedder.url,
+      minSimilarityThreshold: -1,
+      maxDistance: Infinity,
+      maxResults: 10,
+    });
+    await tieto.warm(topic);
+    let i = 0;
+    Deno.bench(`search ${label}`, { group: `search ${label}`, baseline: true }, async () => {
+      await tieto.search(topic, asked[i++ % asked.length]);
+    });
+    Deno.bench(`search filtered ${label}`, { group: `search ${label}` }, async () => {
+      await tieto.search(topic, asked[i++ % asked.length], FILTERS);
+    });
+
+    // the same search, with the first pass on the leading dimensions only
+    if (dim > PREFIX_DIMS) {
+      const coarse = new Tieto({
+        topicsDirectory: topicsDir,
+        embeddingUrl: embedder.url,
+        minSimilarityThreshold: -1,
+        maxDistance: Infinity,
+        maxResults: 10,
+        prefixDims: PREFIX_DIMS,
+      });
+      await coarse.warm(topic);
+      Deno.bench(`search prefix ${PREFIX_DIMS} ${label}`, { group: `search ${label}` }, async () => {
+        await coarse.search(topic, asked[i++ % asked.length]);
+      });
+    }
+
+    // 32 questions one by one vs. the same 32 as one batch
+    const batch = asked.slice(0, 32);
+    Deno.bench(`search x32 ${label}`, { group: `batch ${label}`, baseline: true }, async () => {
+      for (const question of batch) await tieto.search(topic, question);
+    });
+    Deno.bench(`searchBatch x32 ${label}`, { group: `batch ${label}` }, async () => {
+      await tieto.searchBatch(topic, batch);
+    });
+
+    // cold load: read every segment of the topic from disk
+    Deno.bench(`load ${label}`, { group: `load ${label}` }, async () => {
+      tieto.invalidate(topic);
+      await tieto.warm(topic);
+    });
+  }
+}
+
+// benches run after this module is done, so clean up on the way out
+addEventListener("unload", () => {
+  Deno.removeSync(topicsDir, { recursive: true });
+  if (sink < 0) console.log(sink);
+});
@@ -0,0 +1,70 @@
+/**
+ * Coalescing of single-text embedding requests.
+ *
+ * Under load, many searches each want one question embedded. Sending each
+ * as its own request wastes the embedding server's batching (llama.cpp
+ * does several inputs in one forward pass). EmbeddingBatcher gathers the
+ * texts that arrive within `windowMs` of the first one (or until `maxBatch`
+ * of them are waiting) and sends them as one array `input`.
+ *
+ * The same text requested again while it's still queued or on the wire
+ * joins the existing request instead of adding another input.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+export type EmbedSender = (input: string[]) => Promise<Float32Array[]>;
+
+interface Waiting {
+  text: string;
+  resolve: (vec: Float32Array) => void;
+  reject: (e: unknown) => void;
+}
+
+export class EmbeddingBatcher {
+  private send: EmbedSender;
+  private windowMs: number;
+  private maxBatch: number;
+  private queue: Waiting[] = [];
+  private timer?: number;
+  // text → its vector, while queued or in flight
+  private inFlight = new Map<string, Promise<Float32Array>>();
+
+  constructor(send: EmbedSender, windowMs: number, maxBatch: number) {
+    this.send = send;
+    this.windowMs = windowMs;
+    this.maxBatch = Math.max(1, maxBatch);
+  }
+
+  // The vector for `text`; each caller gets its own copy
+  async embed(text: string): Promise<Float32Array> {
+    let vec = this.inFlight.get(text);
+    if (!vec) {
+      vec = new Promise<Float32Array>((resolve, reject) => {
+        this.queue.push({ text, resolve, reject });
+      });
+      this.inFlight.set(text, vec);
+      const forget = () => this.inFlight.delete(text);
+      vec.then(forget, forget);
+
+      if (this.queue.length >= this.maxBatch || this.windowMs <= 0) this.flush();
+      else this.timer ??= setTimeout(() => this.flush(), this.windowMs);
+    }
+    return (await vec).slice();
+  }
+
+  private flush(): void {
+    clearTimeout(this.timer);
+    this.timer = undefined;
+    const batch = this.queue.splice(0, this.maxBatch);
+    // anything past maxBatch goes out in the next window
+    if (this.queue.length) this.timer = setTimeout(() => this.flush(), this.windowMs);
+    if (!batch.length) return;
+
+    this.send(batch.map((w) => w.text)).then(
+      (vecs) => batch.forEach((w, i) => w.resolve(vecs[i])),
+      (e) => batch.forEach((w) => w.reject(e)),
+    );
+  }
+}
@@ -0,0 +1,60 @@
+/**
+ * Tests for embedding request coalescing (batcher.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assertEquals, assertRejects } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { EmbeddingBatcher } from "./batcher.ts";
+
+// a sender that records every batch and embeds a text as [length, first char]
+function recorder(fail = false) {
+  const batches: string[][] = [];
+  const send = (input: string[]) => {
+    batches.push(input);
+    if (fail) return Promise.reject(new Error("embedding server down"));
+    return Promise.resolve(input.map((t) => new Float32Array([t.length, t.charCodeAt(0)])));
+  };
+  return { batches, send };
+}
+
+Deno.test("texts arriving within the window go out as one batch", async () => {
+  const { batches, send } = recorder();
+  const batcher = new EmbeddingBatcher(send, 10, 32);
+  const vecs = await Promise.all(["a", "bb", "ccc"].map((t) => batcher.embed(t)));
+  assertEquals(batches, [["a", "bb", "ccc"]]);
+  assertEquals(vecs.map((v) => Array.from(v)), [[1, 97], [2, 98], [3, 99]]);
+});
+
+Deno.test("a text already waiting is sent once, and each caller gets a copy", async () => {
+  const { batches, send } = recorder();
+  const batcher = new EmbeddingBatcher(send, 10, 32);
+  const [one, two] = await Promise.all([batcher.embed("same"), batcher.embed("same")]);
+  assertEquals(batches, [["same"]]);
+  one[0] = -1;
+  assertEquals(two[0], 4);
+});
+
+Deno.test("batches are split at maxBatch", async () => {
+  const { batches, send } = recorder();
+  const batcher = new EmbeddingBatcher(send, 5, 2);
+  await Promise.all(["a", "b", "c", "d", "e"].map((t) => batcher.embed(t)));
+  assertEquals(batches, [["a", "b"], ["c", "d"], ["e"]]);
+});
+
+Deno.test("with no window every text goes out by itself", async () => {
+  const { batches, send } = recorder();
+  const batcher = new EmbeddingBatcher(send, 0, 32);
+  await Promise.all(["a", "b"].map((t) => batcher.embed(t)));
+  assertEquals(batches, [["a"], ["b"]]);
+});
+
+Deno.test("a failed batch rejects all its callers; the text can be asked for again", async () => {
+  const failing = recorder(true);
+  const batcher = new EmbeddingBatcher(failing.send, 5, 32);
+  const calls = ["x", "y"].map((t) => batcher.embed(t));
+  await Promise.all(calls.map((call) => assertRejects(() => call, Error, "embedding server down")));
+  await assertRejects(() => batcher.embed("x"), Error, "embedding server down");
+  assertEquals(failing.batches, [["x", "y"], ["x"]]);
+});
@@ -0,0 +1,152 @@
+/**
+ * Corpus score statistics for Tieto's thresholds.
+ *
+ * How similar "similar" is depends on the embedding model, the language and
+ * the corpus: a 0.7 cosine that's a strong match in one topic is background
+ * noise in another. Instead of hand-tuning minSimilarityThreshold and
+ * maxDistance per topic, an index-time pass samples chunk-to-chunk pairs of
+ * the topic and records the distribution of their cosine similarities and
+ * Euclidean distances. With `thresholdPercentile` set, search keeps only
+ * chunks scoring better than that share of the sampled pairs: the
+ * similarity floor is that percentile of the similarities, the distance
+ * ceiling the matching low percentile of the distances. Both are looked up
+ * once per topic, not per chunk.
+ *
+ * The pairs are chunks of the topic against each other, not questions
+ * against chunks, so a percentile is a relative setting: 99 means "closer
+ * than all but 1% of what the topic says about itself". Models that embed
+ * questions and passages asymmetrically score questions lower across the
+ * board, and want a lower percentile.
+ *
+ * Layout of {topic}/manifest.json:
+ *
+ *   {version, rows, pairs, builtAt, similarity: [...], distance: [...]}
+ *
+ * where similarity[i] / distance[i] is the i / 10th percentile (1001 points).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { cosineFromDot, RowScorer } from "./kernels.ts";
+import type { Segment } from "./store.ts";
+import { dequantizeRow } from "./quant.ts";
+import { lcg } from "./ivf.ts";
+
+const MANIFEST_VERSION = 1;
+// sampled rows scored against each other: probes x sample pairs at most
+const SAMPLE_ROWS = 4096;
+const PROBE_ROWS = 256;
+// percentile table resolution: points per percent
+const STEPS = 10;
+
+export interface TopicStats {
+  // rows in the topic, and pairs sampled from them
+  rows: number;
+  pairs: number;
+  builtAt: string;
+  // ascending; entry i is the i / STEPS-th percentile
+  similarity: number[];
+  distance: number[];
+}
+
+export interface Thresholds {
+  minSimilarity: number;
+  maxDistance: number;
+}
+
+// Similarity and distance percentiles of random chunk pairs across
+// `segments`, or null when there aren't two rows to pair
+export function sampleStats(segments: Segment[], scorer: RowScorer): TopicStats | null {
+  const refs: [number, number][] = [];
+  segments.forEach((seg, s) => {
+    for (let r = 0; r < seg.count; r++) refs.push([s, r]);
+  });
+  const rows = refs.length;
+  if (rows < 2) return null;
+  const dim = segments.find((seg) => seg.count)!.dim;
+
+  // the sample: a partial Fisher-Yates, seeded so the same corpus gives
+  // the same stats
+  const rand = lcg(rows);
+  const size = Math.min(rows, SAMPLE_ROWS);
+  for (let i = 0; i < size; i++) {
+    const j = i + Math.floor(rand() * (rows - i));
+    [refs[i], refs[j]] = [refs[j], refs[i]];
+  }
+  const m = new Float32Array(size * dim);
+  const norms = new Float32Array(size);
+  for (let i = 0; i < size; i++) {
+    const [s, r] = refs[i];
+    const seg = segments[s];
+    if (seg.dim !== dim) throw new Error("Vectors must have the same dimension.");
+    if (seg.vectors) m.set(seg.vectors.subarray(r * dim, (r + 1) * dim), i * dim);
+    else dequantizeRow(seg.quant!, seg.norms, r, m.subarray(i * dim, (i + 1) * dim));
+    norms[i] = seg.norms[r];
+  }
+
+  // the first rows of the (shuffled) sample against all the others
+  const probes = Math.min(size, PROBE_ROWS);
+  const pairs = probes * (size - 1);
+  const similarity = new Float32Array(pairs);
+  const distance = new Float32Array(pairs);
+  const dots = new Float32Array(size);
+  const sqDists = new Float32Array(size);
+  let at = 0;
+  for (let p = 0; p < probes; p++) {
+    scorer(m, dim, size, m.subarray(p * dim, (p + 1) * dim), dots, sqDists);
+    for (let i = 0; i < size; i++) {
+      if (i === p) continue;
+      similarity[at] = cosineFromDot(dots[i], norms[p], norms[i]);
+      distance[at++] = Math.sqrt(sqDists[i]);
+    }
+  }
+
+  return {
+    rows,
+    pairs,
+    builtAt: new Date().toISOString(),
+    similarity: percentiles(similarity.sort()),
+    distance: percentiles(distance.sort()),
+  };
+}
+
+// 100 * STEPS + 1 evenly spaced points of an ascending array
+function percentiles(sorted: Float32Array): number[] {
+  const out: number[] = [];
+  for (let i = 0; i <= 100 * STEPS; i++) {
+    out.push(sorted[Math.round((i / (100 * STEPS)) * (sorted.length - 1))]);
+  }
+  return out;
+}
+
+// value at percentile `p` (0-100) of a percentiles() table, interpolated
+function lookup(table: number[], p: number): number {
+  const x = Math.min(Math.max(p, 0), 100) * STEPS;
+  const i = Math.floor(x);
+  if (i >= table.length - 1) return table[table.length - 1];
+  return table[i] + (table[i + 1] - table[i]) * (x - i);
+}
+
+// Thresholds that let through what scores better than `percentile` percent
+// of the sampled pairs, on both measures
+export function thresholdsAt(stats: TopicStats, percentile: number): Thresholds {
+  return {
+    minSimilarity: lookup(stats.similarity, percentile),
+    maxDistance: lookup(stats.distance, 100 - percentile),
+  };
+}
+
+export async function writeStats(path: string, stats: TopicStats): Promise<void> {
+  const tmp = `${path}.tmp`;
+  await Deno.writeTextFile(tmp, JSON.stringify({ version: MANIFEST_VERSION, ...stats }));
+  await Deno.rename(tmp, path);
+}
+
+export async function readStats(path: string): Promise<TopicStats> {
+  const { version, ...stats } = JSON.parse(await Deno.readTextFile(path));
+  if (version !== MANIFEST_VERSION) {
+    throw new Error(`Unsupported topic manifest version ${version}: ${path}`);
+  }
+  return stats;
+}
@@ -0,0 +1,192 @@
+/**
+ * Document chunking for Tieto.
+ *
+ * chunkText() cuts a document body into the pieces that get embedded, in
+ * one pass over the text:
+ *
+ *   - "chars" / "tokens": whole sentences are packed into chunks of up to
+ *     `size` characters (or estimated tokens). A chunk ends at a paragraph
+ *     break once it's at least half full, always ends before a markdown
+ *     heading, and a sentence longer than a whole chunk is cut at a space.
+ *     The last `overlap` worth of sentences of a chunk start the next one
+ *     as well, so a passage on a boundary can be found from either side;
+ *     packContext() drops the repeat when both chunks make the prompt.
+ *     Sentences are found heuristically (see sentences.ts).
+ *   - "lines": `size` non-empty, trimmed lines per chunk; the original
+ *     chunking, kept so topics ingested that way hash the same.
+ *
+ * Chunks are contiguous ranges of the body, so each one is a single slice;
+ * nothing is split into lines and joined back together.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { estimateTokens } from "./pack.ts";
+import { isSpace, sentenceEnd } from "./sentences.ts";
+
+export type ChunkUnit = "chars" | "tokens" | "lines";
+
+export interface ChunkOptions {
+  by: ChunkUnit;
+  // budget per chunk, in `by` units
+  size: number;
+  // repeated from the end of one chunk at the start of the next, in `by`
+  // units (ignored for lines)
+  overlap: number;
+}
+
+// default budgets: ~1000 characters is about 250 tokens of English
+export const CHUNK_SIZES: Record<ChunkUnit, number> = { chars: 1000, tokens: 256, lines: 3 };
+
+// a sentence (or heading, or part of an over-long sentence) at
+// body[start, end)
+interface Piece {
+  start: number;
+  end: number;
+  size: number;
+  heading: boolean;
+  // first piece after a blank line
+  paragraph: boolean;
+}
+
+const HEADING = /#{1,6}\s/y;
+
+export function chunkText(body: string, options: ChunkOptions): string[] {
+  if (options.by === "lines") return chunkLines(body, Math.max(1, options.size));
+
+  const size = Math.max(1, options.size);
+  const overlap = Math.min(Math.max(0, options.overlap), size / 2);
+  const byChars = options.by === "chars";
+  const measure = byChars
+    ? (start: number, end: number) => end - start
+    : (start: number, end: number) => estimateTokens(body.slice(start, end));
+
+  const chunks: string[] = [];
+  let current: Piece[] = [];
+  // pieces in `current` that weren't carried over from the previous chunk
+  let fresh = 0;
+  const extent = (from: number, extra?: Piece): number => {
+    if (byChars) {
+      const end = extra ? extra.end : current[current.length - 1].end;
+      return end - current[from].start;
+    }
+    let total = extra ? extra.size : 0;
+    for (let i = from; i < current.length; i++) total += current[i].size;
+    return total;
+  };
+
+  const emit = (carry: boolean) => {
+    if (fresh) chunks.push(body.slice(current[0].start, current[current.length - 1].end));
+    // trailing sentences that fit in the overlap (never the whole chunk)
+    let keep = current.length;
+    if (carry && fresh) while (keep > 1 && extent(keep - 1) <= overlap) keep--;
+    current = current.slice(keep);
+    fresh = 0;
+  };
+
+  for (const piece of pieces(body, size, byChars, measure)) {
+    if (piece.heading) {
+      // a new section: nothing carries over into it
+      emit(false);
+    } else if (current.length) {
+      const full = fresh > 0 && extent(0) >= size / 2;
+      if (extent(0, piece) > size || (piece.paragraph && full)) {
+        emit(true);
+        // what's carried over still has to leave room for this piece
+        while (current.length && extent(0, piece) > size) current.shift();
+      }
+    }
+    current.push(piece);
+    fresh++;
+  }
+  emit(false);
+  return chunks;
+}
+
+// Sentences, headings and line ends of `body`, in order; none bigger than
+// `size` (`measure` units)
+function* pieces(
+  body: string,
+  size: number,
+  byChars: boolean,
+  measure: (start: number, end: number) => number,
+): Generator<Piece> {
+  let paragraph = true;
+  for (let pos = 0; pos <= body.length;) {
+    const nl = body.indexOf("\n", pos);
+    const lineEnd = nl < 0 ? body.length : nl;
+    let start = pos, end = lineEnd;
+    pos = lineEnd + 1;
+    while (start < end && isSpace(body.charCodeAt(start))) start++;
+    while (end > start && isSpace(body.charCodeAt(end - 1))) end--;
+    if (start === end) {
+      paragraph = true;
+      continue;
+    }
+
+    HEADING.lastIndex = start;
+    if (HEADING.test(body)) {
+      yield { start, end, size: measure(start, end), heading: true, paragraph: true };
+      paragraph = false;
+      continue;
+    }
+
+    // sentences end at punctuation followed by a space, and at the line end
+    while (start < end) {
+      const stop = sentenceEnd(body, start, end);
+      for (const [s, e] of fitting(body, start, stop, size, byChars, measure)) {
+        yield { start: s, end: e, size: measure(s, e), heading: false, paragraph };
+        paragraph = false;
+      }
+      start = stop;
+      while (start < end && isSpace(body.charCodeAt(start))) start++;
+    }
+  }
+}
+
+// body[start, end) in parts of at most `size`, cut at spaces where possible
+function* fitting(
+  body: string,
+  start: number,
+  end: number,
+  size: number,
+  byChars: boolean,
+  measure: (start: number, end: number) => number,
+): Generator<[number, number]> {
+  while (start < end) {
+    if (measure(start, end) <= size) {
+      yield [start, end];
+      return;
+    }
+    // a first guess in characters, shrunk until it fits
+    let limit = Math.min(end - start, byChars ? size : size * 4);
+    let cut = start + limit;
+    while (limit > 1 && measure(start, cut) > size) {
+      limit = Math.floor(limit * 0.75);
+      cut = start + limit;
+    }
+    const space = body.lastIndexOf(" ", cut);
+    if (space > start) cut = space;
+    yield [start, cut];
+    start = cut;
+    while (start < end && isSpace(body.charCodeAt(start))) start++;
+  }
+}
+
+// the original chunking: every `size` non-empty lines, trimmed
+function chunkLines(body: string, size: number): string[] {
+  const chunks: string[] = [];
+  let chunk = "", lines = 0;
+  for (const line of body.split("\n")) {
+    const text = line.trim();
+    if (!text) continue;
+    chunk = lines ? `${chunk}\n${text}` : text;
+    if (++lines === size) {
+      chunks.push(chunk);
+      lines = 0;
+    }
+  }
+  if (lines) chunks.push(chunk);
+  return chunks;
+}
@@ -0,0 +1,78 @@
+/**
+ * Tests for document chunking (chunker.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assert, assertEquals } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { chunkText } from "./chunker.ts";
+import { estimateTokens } from "./pack.ts";
+
+const sentence = (n: number) => `Sentence ${n} says something short.`;
+// `n` sentences of 30-odd characters as one paragraph
+const paragraph = (from: number, n: number) =>
+  Array.from({ length: n }, (_, i) => sentence(from + i)).join(" ");
+
+Deno.test("chunks pack whole sentences up to the size", () => {
+  const body = paragraph(0, 20);
+  const chunks = chunkText(body, { by: "chars", size: 120, overlap: 0 });
+  assert(chunks.length > 1);
+  for (const chunk of chunks) {
+    assert(chunk.length <= 120, chunk);
+    assert(chunk.startsWith("Sentence ") && chunk.endsWith("short."), chunk);
+  }
+  // without overlap they are the body, in order, split at spaces
+  assertEquals(chunks.join(" "), body);
+});
+
+Deno.test("token budgets use the same estimate as packContext", () => {
+  const chunks = chunkText(paragraph(0, 30), { by: "tokens", size: 40, overlap: 0 });
+  assert(chunks.length > 1);
+  // counted per sentence, the way the chunker measures its pieces
+  for (const chunk of chunks) {
+    const tokens = chunk.split(/(?<=\.) /).reduce((n, s) => n + estimateTokens(s), 0);
+    assert(tokens <= 40 && tokens > 30, chunk);
+  }
+});
+
+Deno.test("the last sentences of a chunk start the next one", () => {
+  const chunks = chunkText(paragraph(0, 20), { by: "chars", size: 120, overlap: 40 });
+  for (let i = 1; i < chunks.length; i++) {
+    const last = chunks[i - 1].slice(chunks[i - 1].lastIndexOf("Sentence "));
+    assert(chunks[i].startsWith(last), `${chunks[i - 1]} | ${chunks[i]}`);
+    assert(chunks[i].length <= 120);
+  }
+});
+
+Deno.test("headings start a chunk and nothing carries over into them", () => {
+  const body = `${paragraph(0, 2)}\n\n## Next part\n\n${paragraph(2, 2)}`;
+  assertEquals(chunkText(body, { by: "chars", size: 500, overlap: 100 }), [
+    paragraph(0, 2),
+    `## Next part\n\n${paragraph(2, 2)}`,
+  ]);
+});
+
+Deno.test("a chunk ends at a paragraph break once it's half full", () => {
+  const body = `${paragraph(0, 2)}\n\n${paragraph(2, 1)}\n\n${paragraph(3, 4)}`;
+  // the first break comes too early (under half), the second doesn't
+  assertEquals(chunkText(body, { by: "chars", size: 180, overlap: 0 }), [
+    `${paragraph(0, 2)}\n\n${paragraph(2, 1)}`,
+    paragraph(3, 4),
+  ]);
+});
+
+Deno.test("a sentence longer than a chunk is cut at spaces", () => {
+  const body = Array.from({ length: 60 }, (_, i) => `word${i}`).join(" ") + ".";
+  const chunks = chunkText(body, { by: "chars", size: 50, overlap: 0 });
+  assert(chunks.length > 1);
+  for (const chunk of chunks) assert(chunk.length <= 50 && /^word\d+/.test(chunk), chunk);
+  assertEquals(chunks.join(" "), body);
+});
+
+Deno.test("lines mode keeps the original N-lines chunking", () => {
+  assertEquals(chunkText("  one\n\ntwo  \nthree\nfour\n", { by: "lines", size: 3, overlap: 5 }), [
+    "one\ntwo\nthree",
+    "four",
+  ]);
+});
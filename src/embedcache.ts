@@ -0,0 +1,91 @@
+/**
+ * Query embedding cache for Tieto.
+ *
+ * An LRU of text → embedding, so a question that was asked before doesn't
+ * go back to the embedding server. Entries are keyed by a SHA-256 of the
+ * embedding model (or URL) and the text, so switching models never serves
+ * a stale vector.
+ *
+ * With a directory, the cache also has a disk tier: each entry is one
+ * file of raw Float32s named after its key (sharded by the first two hex
+ * digits), written when the entry is added and read back on a memory miss.
+ * The disk tier is best-effort; a failed read or write is just a miss.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { writeAtomic } from "./store.ts";
+
+export class EmbeddingCache {
+  readonly size: number;
+  private namespace: string;
+  private dir?: string;
+  private entries = new Map<string, Float32Array>();
+
+  // `namespace` is the embedding model (or URL); `dir` enables the disk tier
+  constructor(size: number, namespace: string, dir?: string) {
+    this.size = size;
+    this.namespace = namespace;
+    this.dir = dir;
+  }
+
+  private async key(text: string): Promise<string> {
+    const digest = await crypto.subtle.digest(
+      "SHA-256",
+      new TextEncoder().encode(`${this.namespace}\n${text}`),
+    );
+    return Array.from(new Uint8Array(digest), (b) => b.toString(16).padStart(2, "0")).join("");
+  }
+
+  private pathFor(key: string): string {
+    return join(this.dir!, key.slice(0, 2), `${key}.f32`);
+  }
+
+  // most recently used last, oldest dropped first
+  private remember(key: string, vec: Float32Array): void {
+    this.entries.delete(key);
+    this.entries.set(key, vec);
+    while (this.entries.size > this.size) {
+      this.entries.delete(this.entries.keys().next().value!);
+    }
+  }
+
+  async get(text: string): Promise<Float32Array | undefined> {
+    const key = await this.key(text);
+    let vec = this.entries.get(key);
+    if (!vec && this.dir) {
+      try {
+        const bytes = await Deno.readFile(this.pathFor(key));
+        if (bytes.byteLength && bytes.byteLength % 4 === 0) {
+          vec = new Float32Array(bytes.slice().buffer);
+        }
+      } catch {
+        // not cached on disk (or unreadable): a miss
+      }
+    }
+    if (!vec) return undefined;
+    this.remember(key, vec);
+    // a copy, so callers can't change what the next hit gets
+    return vec.slice();
+  }
+
+  async set(text: string, vec: Float32Array): Promise<void> {
+    const key = await this.key(text);
+    const own = vec.slice();
+    this.remember(key, own);
+    if (!this.dir) return;
+    try {
+      const path = this.pathFor(key);
+      await Deno.mkdir(join(this.dir, key.slice(0, 2)), { recursive: true });
+      await writeAtomic(path, new Uint8Array(own.buffer));
+    } catch {
+      // the memory tier still has it
+    }
+  }
+
+  clear(): void {
+    this.entries.clear();
+  }
+}
@@ -0,0 +1,154 @@
+/**
+ * Frontmatter filters for Tieto.
+ *
+ * A query's filters are a list of expressions that must all hold. Each one
+ * is either a plain comparison ({key, op, value}) or a group: `any` (OR),
+ * `all` (AND) or `not`. compileFilters() turns that list into a tree of
+ * predicates once per query. Numeric / date right-hand sides are parsed up
+ * front, `in` lists become Sets, and AND-ed parts are ordered so the ones
+ * most likely to reject a chunk run first. The per-chunk check and the
+ * metadata index (metaindex.ts) both evaluate the compiled form, so a
+ * filter means exactly the same thing on either path.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+export type Op = "=" | ">=" | "<=" | ">" | "<" | "in";
+
+export interface Filter {
+  key: string;
+  op: Op;
+  value: string | string[];
+}
+
+export type FilterExpr =
+  | Filter
+  | { any: FilterExpr[] }
+  | { all: FilterExpr[] }
+  | { not: FilterExpr };
+
+export type Range = ">=" | "<=" | ">" | "<";
+
+const OPS = new Set<string>(["=", ">=", "<=", ">", "<", "in"]);
+
+// Whether an untrusted value (e.g. from a request body) has the shape of a
+// FilterExpr, all the way down
+export function isFilterExpr(x: unknown): x is FilterExpr {
+  if (!x || typeof x !== "object" || Array.isArray(x)) return false;
+  const e = x as Record<string, unknown>;
+  if ("any" in e) return Array.isArray(e.any) && e.any.every(isFilterExpr);
+  if ("all" in e) return Array.isArray(e.all) && e.all.every(isFilterExpr);
+  if ("not" in e) return isFilterExpr(e.not);
+  const { key, op, value } = e;
+  return typeof key === "string" && typeof op === "string" && OPS.has(op) &&
+    (typeof value === "string" ||
+      (Array.isArray(value) && value.every((v) => typeof v === "string")));
+}
+
+// One compiled expression. `test` answers it for a single chunk's metadata.
+export type Compiled = { test: (meta: Record<string, unknown>) => boolean } & (
+  | { kind: "eq"; key: string; value: string }
+  | { kind: "in"; key: string; values: Set<string> }
+  | { kind: "range"; key: string; op: Range; right: number }
+  | { kind: "all" | "any"; parts: Compiled[] }
+  | { kind: "not"; part: Compiled }
+  | { kind: "never" }
+);
+
+// convert arrays, objects → string consistently for comparison; null for
+// a missing key (which never matches)
+export function metaString(raw: unknown): string | null {
+  if (raw === undefined || raw === null) return null;
+  return Array.isArray(raw) ? raw.join(",") : raw.toString();
+}
+
+// numeric or date value of a string (NaN if it's neither)
+export function metaNumber(str: string): number {
+  return Number(str) || Date.parse(str);
+}
+
+// right-hand side of an `in` filter as a list
+export function inList(value: string | string[]): string[] {
+  return Array.isArray(value) ? value : value.split(",");
+}
+
+function rangeTest(op: Range, right: number): (left: number) => boolean {
+  switch (op) {
+    case ">=":
+      return (left) => left >= right;
+    case "<=":
+      return (left) => left <= right;
+    case ">":
+      return (left) => left > right;
+    case "<":
+      return (left) => left < right;
+  }
+}
+
+const NEVER: Compiled = { kind: "never", test: () => false };
+
+// rough order in which AND-ed parts should run: cheapest and most
+// selective first
+function rank(c: Compiled): number {
+  switch (c.kind) {
+    case "never":
+      return 0;
+    case "eq":
+      return 1;
+    case "in":
+      return 2 + c.values.size / 1e6;
+    case "range":
+      return 3;
+    default:
+      return 4;
+  }
+}
+
+function compileOne(expr: FilterExpr): Compiled {
+  if ("any" in expr) {
+    const parts = expr.any.map(compileOne).filter((c) => c.kind !== "never");
+    if (!parts.length) return NEVER;
+    if (parts.length === 1) return parts[0];
+    return { kind: "any", parts, test: (meta) => parts.some((c) => c.test(meta)) };
+  }
+  if ("all" in expr) return compileFilters(expr.all);
+  if ("not" in expr) {
+    const part = compileOne(expr.not);
+    return { kind: "not", part, test: (meta) => !part.test(meta) };
+  }
+
+  const { key, op, value } = expr;
+  if (op === "=") {
+    if (Array.isArray(value)) return NEVER;
+    return { kind: "eq", key, value, test: (meta) => metaString(meta?.[key]) === value };
+  }
+  if (op === "in") {
+    const values = new Set(inList(value));
+    const test = (meta: Record<string, unknown>) => {
+      const str = metaString(meta?.[key]);
+      return str !== null && values.has(str);
+    };
+    return { kind: "in", key, values, test };
+  }
+
+  // numeric or date compare
+  const right = metaNumber(value as string);
+  if (isNaN(right)) return NEVER;
+  const within = rangeTest(op, right);
+  const test = (meta: Record<string, unknown>) => {
+    const str = metaString(meta?.[key]);
+    if (str === null) return false;
+    const left = metaNumber(str);
+    return !isNaN(left) && within(left);
+  };
+  return { kind: "range", key, op, right, test };
+}
+
+// Compile a query's filters (all of which must hold) into one predicate
+export function compileFilters(filters: FilterExpr[]): Compiled {
+  const parts = filters.map(compileOne).sort((a, b) => rank(a) - rank(b));
+  if (parts.length === 1) return parts[0];
+  if (parts[0]?.kind === "never") return NEVER;
+  return { kind: "all", parts, test: (meta) => parts.every((c) => c.test(meta)) };
+}
@@ -0,0 +1,81 @@
+/**
+ * Tests for the filter compiler (filters.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assert, assertEquals } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { compileFilters, isFilterExpr } from "./filters.ts";
+
+const doc = { tag: ["a", "b"], weight: "12", date: "2024-02-10", draft: false };
+
+Deno.test("comparisons use the string, number or date form of the value", () => {
+  assert(compileFilters([{ key: "tag", op: "=", value: "a,b" }]).test(doc));
+  assert(compileFilters([{ key: "draft", op: "=", value: "false" }]).test(doc));
+  assert(compileFilters([{ key: "weight", op: ">", value: "9" }]).test(doc));
+  assert(compileFilters([{ key: "date", op: "<", value: "2024-03-01" }]).test(doc));
+  assert(compileFilters([{ key: "weight", op: "in", value: ["3", "12"] }]).test(doc));
+  assert(!compileFilters([{ key: "missing", op: "in", value: "x" }]).test(doc));
+  assert(!compileFilters([{ key: "weight", op: "<=", value: "11" }]).test(doc));
+});
+
+Deno.test("any, all and not groups nest", () => {
+  const c = compileFilters([{
+    any: [
+      { key: "weight", op: "<", value: "5" },
+      {
+        all: [
+          { key: "date", op: ">=", value: "2024-01-01" },
+          { not: { key: "draft", op: "=", value: "true" } },
+        ],
+      },
+    ],
+  }]);
+  assert(c.test(doc));
+  assert(!c.test({ ...doc, draft: true }));
+  assert(c.test({ weight: 2 }));
+});
+
+Deno.test("unparseable right-hand sides compile to never", () => {
+  assertEquals(compileFilters([{ key: "weight", op: ">", value: "heavy" }]).kind, "never");
+  assertEquals(compileFilters([{ key: "tag", op: "=", value: ["a", "b"] }]).kind, "never");
+  assertEquals(compileFilters([{ any: [{ key: "date", op: "<", value: "soon" }] }]).kind, "never");
+  // one never part sinks the whole AND
+  const c = compileFilters([
+    { key: "weight", op: ">", value: "1" },
+    { key: "date", op: "<", value: "soon" },
+  ]);
+  assertEquals(c.kind, "never");
+  assert(!c.test(doc));
+});
+
+Deno.test("AND-ed parts run cheapest first", () => {
+  const c = compileFilters([
+    { not: { key: "draft", op: "=", value: "true" } },
+    { key: "weight", op: ">", value: "1" },
+    { key: "tag", op: "in", value: "x,y" },
+    { key: "tag", op: "=", value: "a,b" },
+  ]);
+  assert(c.kind === "all");
+  assertEquals(c.parts.map((p) => p.kind), ["eq", "in", "range", "not"]);
+});
+
+Deno.test("isFilterExpr checks untrusted filters all the way down", () => {
+  assert(isFilterExpr({ key: "tag", op: "in", value: ["a", "b"] }));
+  assert(isFilterExpr({
+    any: [{ key: "n", op: ">", value: "1" }, { not: { key: "x", op: "=", value: "" } }],
+  }));
+  assert(isFilterExpr({ all: [] }));
+  const bad: unknown[] = [
+    null,
+    "tag=a",
+    [{ key: "tag", op: "=", value: "a" }],
+    { key: "tag", op: "~", value: "a" },
+    { key: "tag", op: "=", value: 3 },
+    { key: "tag", op: "in", value: ["a", 1] },
+    { any: { key: "tag", op: "=", value: "a" } },
+    { not: { all: [{ key: 1, op: "=", value: "a" }] } },
+  ];
+  for (const x of bad) assert(!isFilterExpr(x), JSON.stringify(x));
+});
@@ -0,0 +1,195 @@
+/**
+ * Shared HTTP client for the embedding and completion servers.
+ *
+ * Every request goes through one policy:
+ *
+ *   - an idle timeout per attempt (AbortSignal): the attempt is aborted
+ *     once the server has sent nothing for `timeout` ms, be it headers or
+ *     body, so a stalled server can't hang an ingest, while a long
+ *     streamed completion that keeps producing tokens is left alone
+ *   - bounded retries of transient failures (network errors, timeouts,
+ *     408 / 425 / 429 / 5xx gateway errors) with exponential backoff and
+ *     full jitter, honouring Retry-After when the server sends one. Only
+ *     failures before a response count; once `read` has the response, an
+ *     error reading its body is final
+ *   - at most maxInFlight requests on the wire at once, a request holding
+ *     its slot until its body has been read or cancelled (waiting out a
+ *     backoff doesn't hold one)
+ *
+ * Connections are pooled and kept alive by fetch itself, per origin; the
+ * client's part is making sure every response body is read or cancelled,
+ * including the ones it retries, so a connection is never stranded.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { createSlots } from "./limit.ts";
+
+export interface HttpPolicy {
+  // milliseconds an attempt may go without receiving anything
+  timeout: number;
+  // extra attempts after the first
+  retries: number;
+  // requests in flight at once
+  maxInFlight: number;
+}
+
+// Send a request and turn the response into T with `read`. `read` runs
+// under the same timeout and only sees the final attempt's response; it
+// may also hand the response on (to stream its body), and the idle
+// timeout keeps watching the body until it ends.
+export type HttpClient = <T>(
+  url: string,
+  init: RequestInit,
+  read: (res: Response) => Promise<T>,
+) => Promise<T>;
+
+const RETRY_STATUS = new Set([408, 425, 429, 500, 502, 503, 504]);
+const BASE_DELAY = 250;
+const MAX_DELAY = 10_000;
+// longest Retry-After we'll actually sit through
+const MAX_RETRY_AFTER = 60_000;
+
+// thrown inside an attempt to ask for another one
+class Retryable extends Error {
+  retryAfter?: number;
+  constructor(message: string, retryAfter?: number) {
+    super(message);
+    this.retryAfter = retryAfter;
+  }
+}
+
+// Retry-After as milliseconds (it's either seconds or an HTTP date)
+function retryAfterMs(res: Response): number | undefined {
+  const header = res.headers.get("retry-after");
+  if (!header) return undefined;
+  const seconds = Number(header);
+  if (!isNaN(seconds)) return seconds * 1000;
+  const at = Date.parse(header);
+  return isNaN(at) ? undefined : Math.max(0, at - Date.now());
+}
+
+function isTimeout(e: unknown): boolean {
+  return e instanceof DOMException && (e.name === "TimeoutError" || e.name === "AbortError");
+}
+
+// fetch() rejects with a TypeError when the connection itself fails
+function isTransient(e: unknown): boolean {
+  return e instanceof Retryable || e instanceof TypeError || isTimeout(e);
+}
+
+interface IdleSignal {
+  signal: AbortSignal;
+  // something arrived; restart the clock
+  touch(): void;
+  stop(): void;
+  // give up on the attempt, taking whatever is left of the body with it
+  abort(): void;
+}
+
+function idleSignal(timeout: number): IdleSignal {
+  const controller = new AbortController();
+  let timer = 0;
+  const stop = () => clearTimeout(timer);
+  const touch = () => {
+    stop();
+    timer = setTimeout(
+      () => controller.abort(new DOMException("Request timed out", "TimeoutError")),
+      timeout,
+    );
+    // a leftover timer (say, a stream the caller stopped reading) must not
+    // keep the process alive
+    Deno.unrefTimer(timer);
+  };
+  touch();
+  return { signal: controller.signal, touch, stop, abort: () => controller.abort() };
+}
+
+// The same response, with every body chunk restarting the idle clock.
+// `done` runs once the body has been read to the end, cancelled or has
+// failed.
+function watchBody(res: Response, idle: IdleSignal, done: () => void): Response {
+  idle.touch();
+  if (!res.body) {
+    done();
+    return res;
+  }
+  const reader = res.body.getReader();
+  const body = new ReadableStream<Uint8Array>({
+    async pull(controller) {
+      try {
+        const { done: end, value } = await reader.read();
+        if (end) {
+          done();
+          controller.close();
+        } else {
+          idle.touch();
+          controller.enqueue(value);
+        }
+      } catch (e) {
+        done();
+        controller.error(e);
+      }
+    },
+    cancel(reason) {
+      done();
+      return reader.cancel(reason);
+    },
+  });
+  return new Response(body, {
+    status: res.status,
+    statusText: res.statusText,
+    headers: res.headers,
+  });
+}
+
+export function createHttpClient(policy: HttpPolicy): HttpClient {
+  const slots = createSlots(policy.maxInFlight);
+
+  return async <T>(
+    url: string,
+    init: RequestInit,
+    read: (res: Response) => Promise<T>,
+  ): Promise<T> => {
+    for (let attempt = 0;; attempt++) {
+      const last = attempt >= policy.retries;
+      let retryAfter: number | undefined;
+      // once a response is in, failures are the final answer: the server
+      // may have acted on the request, and `read` may have consumed part
+      // of the body
+      let responded = false;
+      const release = await slots();
+      const idle = idleSignal(policy.timeout);
+      // the slot is held until the body is done, not just the headers
+      const finish = () => {
+        idle.stop();
+        release();
+      };
+      // a body nobody reads or cancels gives its slot back when it idles
+      // out
+      idle.signal.addEventListener("abort", finish, { once: true });
+      try {
+        const res = await fetch(url, { ...init, signal: idle.signal });
+        if (!last && RETRY_STATUS.has(res.status)) {
+          await res.body?.cancel();
+          throw new Retryable(`${res.status} from ${url}`, retryAfterMs(res));
+        }
+        responded = true;
+        return await read(watchBody(res, idle, finish));
+      } catch (e) {
+        // `read` gave up part way; don't leave the rest of the body behind
+        if (responded) idle.abort();
+        finish();
+        if ((last || responded) && isTimeout(e)) {
+          throw new Error(`Request timed out after ${policy.timeout} ms: ${url}`);
+        }
+        if (last || responded || !isTransient(e)) throw e;
+        if (e instanceof Retryable) retryAfter = e.retryAfter;
+      }
+      const delay = Math.random() * Math.min(MAX_DELAY, BASE_DELAY * 2 ** attempt);
+      const wait = Math.max(delay, Math.min(retryAfter ?? 0, MAX_RETRY_AFTER));
+      await new Promise((resolve) => setTimeout(resolve, wait));
+    }
+  };
+}
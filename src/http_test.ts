@@ -0,0 +1,156 @@
+/**
+ * Tests for the shared HTTP client (http.ts), against a local server.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assert, assertEquals, assertRejects } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { createHttpClient, HttpPolicy } from "./http.ts";
+
+const policy: HttpPolicy = { timeout: 2000, retries: 2, maxInFlight: 4 };
+const text = (res: Response) => res.text();
+const sleep = (ms: number) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// serve `handler` on a free port for the length of `fn`
+async function withServer(
+  handler: (req: Request) => Response | Promise<Response>,
+  fn: (url: string) => Promise<void>,
+) {
+  const server = Deno.serve({ port: 0, hostname: "127.0.0.1", onListen() {} }, handler);
+  try {
+    await fn(`http://127.0.0.1:${server.addr.port}/`);
+  } finally {
+    await server.shutdown();
+  }
+}
+
+Deno.test("transient statuses are retried", async () => {
+  let calls = 0;
+  const handler = () => ++calls < 3 ? new Response("busy", { status: 503 }) : new Response("ok");
+  await withServer(handler, async (url) => {
+    assertEquals(await createHttpClient(policy)(url, {}, text), "ok");
+  });
+  assertEquals(calls, 3);
+});
+
+Deno.test("the last attempt's response goes to read, whatever its status", async () => {
+  let calls = 0;
+  await withServer(() => (calls++, new Response("busy", { status: 503 })), async (url) => {
+    const status = await createHttpClient(policy)(url, {}, async (res) => {
+      await res.body?.cancel();
+      return res.status;
+    });
+    assertEquals(status, 503);
+  });
+  assertEquals(calls, policy.retries + 1);
+});
+
+Deno.test("client errors are not retried", async () => {
+  let calls = 0;
+  await withServer(() => (calls++, new Response("no", { status: 400 })), async (url) => {
+    assertEquals(await createHttpClient(policy)(url, {}, text), "no");
+  });
+  assertEquals(calls, 1);
+});
+
+Deno.test("Retry-After is honoured", async () => {
+  const seen: number[] = [];
+  await withServer(() => {
+    seen.push(Date.now());
+    return seen.length === 1
+      ? new Response("slow down", { status: 429, headers: { "retry-after": "1" } })
+      : new Response("ok");
+  }, async (url) => {
+    assertEquals(await createHttpClient(policy)(url, {}, text), "ok");
+  });
+  assertEquals(seen.length, 2);
+  assert(seen[1] - seen[0] >= 900, `retried after ${seen[1] - seen[0]} ms`);
+});
+
+Deno.test("a server that never answers times out", async () => {
+  await withServer(async () => {
+    await sleep(400);
+    return new Response("late");
+  }, async (url) => {
+    const client = createHttpClient({ timeout: 50, retries: 0, maxInFlight: 1 });
+    await assertRejects(() => client(url, {}, text), Error, "Request timed out after 50 ms");
+  });
+});
+
+// `chunks` pieces of body, `gap` ms apart
+function trickle(chunks: number, gap: number): Response {
+  let sent = 0;
+  const body = new ReadableStream<Uint8Array>({
+    async pull(controller) {
+      if (sent === chunks) return controller.close();
+      await sleep(gap);
+      controller.enqueue(new TextEncoder().encode(`${sent++};`));
+    },
+  });
+  return new Response(body);
+}
+
+Deno.test("a body that stalls times out too", async () => {
+  await withServer(() => trickle(2, 400), async (url) => {
+    const client = createHttpClient({ timeout: 100, retries: 0, maxInFlight: 1 });
+    await assertRejects(() => client(url, {}, text), Error, "Request timed out after 100 ms");
+  });
+});
+
+Deno.test("a body that keeps arriving isn't cut off", async () => {
+  await withServer(() => trickle(8, 40), async (url) => {
+    const client = createHttpClient({ timeout: 150, retries: 0, maxInFlight: 1 });
+    assertEquals(await client(url, {}, text), "0;1;2;3;4;5;6;7;");
+  });
+});
+
+Deno.test("no more than maxInFlight requests reach the server at once", async () => {
+  let active = 0, peak = 0;
+  await withServer(async () => {
+    peak = Math.max(peak, ++active);
+    await sleep(20);
+    active--;
+    return new Response("ok");
+  }, async (url) => {
+    const client = createHttpClient({ ...policy, maxInFlight: 2 });
+    const out = await Promise.all(Array.from({ length: 8 }, () => client(url, {}, text)));
+    assertEquals(out.length, 8);
+  });
+  assertEquals(peak, 2);
+});
+
+Deno.test("a body handed on keeps its slot until it's read or cancelled", async () => {
+  let calls = 0;
+  await withServer(() => (calls++, new Response("ok")), async (url) => {
+    const client = createHttpClient({ ...policy, maxInFlight: 1 });
+    for (const finish of [(res: Response) => res.text(), (res: Response) => res.body!.cancel()]) {
+      const before = calls;
+      const first = await client(url, {}, (res) => Promise.resolve(res));
+      const second = client(url, {}, text);
+      await sleep(50);
+      assertEquals(calls, before + 1);
+      await finish(first);
+      assertEquals(await second, "ok");
+      assertEquals(calls, before + 2);
+    }
+  });
+});
+
+Deno.test("a body that fails part way is not retried", async () => {
+  let calls = 0;
+  await withServer(() => {
+    calls++;
+    const body = new ReadableStream<Uint8Array>({
+      async pull(controller) {
+        controller.enqueue(new TextEncoder().encode("partial"));
+        await sleep(20);
+        controller.error(new Error("gone"));
+      },
+    });
+    return new Response(body);
+  }, async (url) => {
+    await assertRejects(() => createHttpClient(policy)(url, {}, text));
+  });
+  assertEquals(calls, 1);
+});
@@ -0,0 +1,254 @@
+/**
+ * IVF (inverted file) approximate nearest-neighbour index for Tieto.
+ *
+ * Rows of every segment in a topic are clustered with spherical k-means:
+ * centroids are unit vectors, and each row goes to the list of the centroid
+ * it has the highest dot product with. At query time only the `nprobe`
+ * lists whose centroids are closest to the question get scanned, instead
+ * of the whole topic.
+ *
+ * The index remembers the fingerprint of each segment it was built from. A
+ * segment that was re-ingested (or added) after the index was built simply
+ * isn't covered by it, and search scans that segment in full. Rebuilding
+ * with `tieto index <topic>` folds it back in.
+ *
+ * Layout of {topic}/ivf.bin:
+ *
+ *   u32 magic, u32 header byte length, JSON header (padded to 4 bytes),
+ *   Float32 centroids (nlist * dim), Uint32 list offsets (nlist + 1),
+ *   Uint32 postings as (segment, row) pairs, grouped by list
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import type { RowScorer } from "./kernels.ts";
+import type { Segment } from "./store.ts";
+import { dequantizeRow } from "./quant.ts";
+
+// "TIVF" read as a little-endian u32
+const IVF_MAGIC = 0x46564954;
+const IVF_VERSION = 1;
+
+export interface IvfSource {
+  // segment name relative to the memory directory
+  name: string;
+  fingerprint: string;
+  segment: Segment;
+}
+
+export interface IvfIndex {
+  dim: number;
+  nlist: number;
+  // per covered segment: name + fingerprint at build time
+  segments: { name: string; fingerprint: string; count: number }[];
+  centroids: Float32Array;
+  offsets: Uint32Array;
+  postings: Uint32Array;
+}
+
+export interface IvfBuildOptions {
+  // number of lists; 0 picks sqrt(rows)
+  nlist?: number;
+  // k-means rounds
+  iterations?: number;
+  // training rows per list (the rest are only assigned)
+  samplesPerList?: number;
+}
+
+// small deterministic PRNG so rebuilding the same corpus gives the same index
+export function lcg(seed: number): () => number {
+  let state = seed >>> 0;
+  return () => {
+    state = (Math.imul(state, 1664525) + 1013904223) >>> 0;
+    return state / 0x100000000;
+  };
+}
+
+// index of the best centroid for one row, by dot product
+function nearest(
+  scorer: RowScorer,
+  centroids: Float32Array,
+  dim: number,
+  nlist: number,
+  row: Float32Array,
+  dots: Float32Array,
+  sqDists: Float32Array,
+): number {
+  scorer(centroids, dim, nlist, row, dots, sqDists);
+  let best = 0;
+  for (let c = 1; c < nlist; c++) if (dots[c] > dots[best]) best = c;
+  return best;
+}
+
+export function buildIvf(
+  sources: IvfSource[],
+  scorer: RowScorer,
+  options: IvfBuildOptions = {},
+): IvfIndex {
+  const dim = sources.find((s) => s.segment.count)?.segment.dim ?? 0;
+  // every (segment, row) in the topic
+  const refs: [number, number][] = [];
+  sources.forEach((s, i) => {
+    if (s.segment.dim !== dim) {
+      throw new Error("Vectors must have the same dimension.");
+    }
+    for (let r = 0; r < s.segment.count; r++) refs.push([i, r]);
+  });
+
+  const total = refs.length;
+  const nlist = Math.max(1, Math.min(total, options.nlist || Math.round(Math.sqrt(total))));
+  const iterations = options.iterations ?? 10;
+  const rand = lcg(total);
+
+  // segments that only kept quantized rows get clustered on a reconstruction
+  const scratch = new Float32Array(dim);
+  const rowOf = ([s, r]: [number, number]) => {
+    const seg = sources[s].segment;
+    if (seg.vectors) return seg.vectors.subarray(r * dim, (r + 1) * dim);
+    return dequantizeRow(seg.quant!, seg.norms, r, scratch);
+  };
+  const normOf = ([s, r]: [number, number]) => sources[s].segment.norms[r] || 1;
+
+  // training sample (partial Fisher-Yates over a copy of the refs)
+  const sampleSize = Math.min(total, nlist * (options.samplesPerList ?? 64));
+  const sample = refs.slice();
+  for (let i = 0; i < sampleSize; i++) {
+    const j = i + Math.floor(rand() * (total - i));
+    [sample[i], sample[j]] = [sample[j], sample[i]];
+  }
+  sample.length = sampleSize;
+
+  // seed centroids with the first nlist sampled rows, normalized
+  const centroids = new Float32Array(nlist * dim);
+  const seed = (c: number, ref: [number, number]) => {
+    const v = rowOf(ref), n = normOf(ref);
+    for (let d = 0; d < dim; d++) centroids[c * dim + d] = v[d] / n;
+  };
+  for (let c = 0; c < nlist; c++) seed(c, sample[c % sampleSize]);
+
+  const dots = new Float32Array(nlist);
+  const sqDists = new Float32Array(nlist);
+  const sums = new Float64Array(nlist * dim);
+  const sizes = new Uint32Array(nlist);
+
+  for (let it = 0; it < iterations; it++) {
+    sums.fill(0);
+    sizes.fill(0);
+    for (const ref of sample) {
+      const v = rowOf(ref), n = normOf(ref);
+      const c = nearest(scorer, centroids, dim, nlist, v, dots, sqDists);
+      sizes[c]++;
+      for (let d = 0; d < dim; d++) sums[c * dim + d] += v[d] / n;
+    }
+    for (let c = 0; c < nlist; c++) {
+      // an empty list gets a fresh random row
+      if (!sizes[c]) {
+        seed(c, sample[Math.floor(rand() * sampleSize)]);
+        continue;
+      }
+      let n = 0;
+      for (let d = 0; d < dim; d++) n += sums[c * dim + d] ** 2;
+      n = Math.sqrt(n) || 1;
+      for (let d = 0; d < dim; d++) centroids[c * dim + d] = sums[c * dim + d] / n;
+    }
+  }
+
+  // assign every row, then lay postings out list by list
+  const assignment = new Uint32Array(total);
+  const counts = new Uint32Array(nlist);
+  refs.forEach((ref, i) => {
+    const c = nearest(scorer, centroids, dim, nlist, rowOf(ref), dots, sqDists);
+    assignment[i] = c;
+    counts[c]++;
+  });
+  const offsets = new Uint32Array(nlist + 1);
+  for (let c = 0; c < nlist; c++) offsets[c + 1] = offsets[c] + counts[c];
+  const cursor = offsets.slice(0, nlist);
+  const postings = new Uint32Array(total * 2);
+  refs.forEach(([s, r], i) => {
+    const at = cursor[assignment[i]]++ * 2;
+    postings[at] = s;
+    postings[at + 1] = r;
+  });
+
+  return {
+    dim,
+    nlist,
+    segments: sources.map((s) => ({
+      name: s.name,
+      fingerprint: s.fingerprint,
+      count: s.segment.count,
+    })),
+    centroids,
+    offsets,
+    postings,
+  };
+}
+
+// The `nprobe` lists nearest the (raw) query vector, by centroid dot product
+export function probeLists(
+  index: IvfIndex,
+  q: Float32Array,
+  nprobe: number,
+  scorer: RowScorer,
+): number[] {
+  const dots = new Float32Array(index.nlist);
+  const sqDists = new Float32Array(index.nlist);
+  scorer(index.centroids, index.dim, index.nlist, q, dots, sqDists);
+  const order = Array.from({ length: index.nlist }, (_, c) => c);
+  order.sort((a, b) => dots[b] - dots[a]);
+  return order.slice(0, Math.max(1, nprobe));
+}
+
+export async function writeIvf(path: string, index: IvfIndex): Promise<void> {
+  const header = new TextEncoder().encode(JSON.stringify({
+    version: IVF_VERSION,
+    dim: index.dim,
+    nlist: index.nlist,
+    segments: index.segments,
+  }));
+  const headerBytes = (header.byteLength + 3) & ~3;
+  const total = 8 + headerBytes + index.centroids.byteLength +
+    index.offsets.byteLength + index.postings.byteLength;
+  const bytes = new Uint8Array(total);
+  const view = new DataView(bytes.buffer);
+  view.setUint32(0, IVF_MAGIC, true);
+  view.setUint32(4, headerBytes, true);
+  bytes.set(header, 8);
+  // pad with spaces so the header stays valid JSON
+  bytes.fill(0x20, 8 + header.byteLength, 8 + headerBytes);
+  let at = 8 + headerBytes;
+  for (const part of [index.centroids, index.offsets, index.postings]) {
+    bytes.set(new Uint8Array(part.buffer, part.byteOffset, part.byteLength), at);
+    at += part.byteLength;
+  }
+  const tmp = `${path}.tmp`;
+  await Deno.writeFile(tmp, bytes);
+  await Deno.rename(tmp, path);
+}
+
+export async function readIvf(path: string): Promise<IvfIndex> {
+  const bytes = await Deno.readFile(path);
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  if (bytes.byteLength < 8 || view.getUint32(0, true) !== IVF_MAGIC) {
+    throw new Error(`Not a Tieto IVF index: ${path}`);
+  }
+  const headerBytes = view.getUint32(4, true);
+  const header = JSON.parse(new TextDecoder().decode(bytes.subarray(8, 8 + headerBytes)));
+  if (header.version !== IVF_VERSION) {
+    throw new Error(`Unsupported IVF index version ${header.version}: ${path}`);
+  }
+  const { dim, nlist } = header;
+  // copy out so the typed arrays are aligned regardless of the read buffer
+  let at = 8 + headerBytes;
+  const take = (n: number) => {
+    const part = bytes.slice(at, at + n * 4);
+    at += n * 4;
+    return part.buffer;
+  };
+  const centroids = new Float32Array(take(nlist * dim));
+  const offsets = new Uint32Array(take(nlist + 1));
+  const postings = new Uint32Array(take(offsets[nlist] * 2));
+  return { dim, nlist, segments: header.segments, centroids, offsets, postings };
+}
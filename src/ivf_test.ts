@@ -0,0 +1,56 @@
+/**
+ * Tests for the IVF index (ivf.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assertEquals, assertRejects } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { scoreRows } from "./kernels.ts";
+import { buildIvf, IvfSource, probeLists, readIvf, writeIvf } from "./ivf.ts";
+import { randomRows, segmentOf, withTempDir } from "./test_util.ts";
+
+const DIM = 16;
+
+function source(name: string, count: number, seed: number): IvfSource {
+  const segment = segmentOf(randomRows(count, DIM, seed), DIM);
+  return { name, fingerprint: `${name}:${count}`, segment };
+}
+
+const sources = () => [source("a/one", 150, 1), source("b/two", 90, 2)];
+
+Deno.test("buildIvf posts every row to exactly one list", () => {
+  const index = buildIvf(sources(), scoreRows, { nlist: 7 });
+  assertEquals(index.nlist, 7);
+  assertEquals(index.offsets[index.nlist], 240);
+  const posted = new Set<string>();
+  for (let i = 0; i < index.offsets[index.nlist]; i++) {
+    posted.add(`${index.postings[2 * i]}:${index.postings[2 * i + 1]}`);
+  }
+  assertEquals(posted.size, 240);
+});
+
+Deno.test("probeLists returns the nprobe lists asked for", () => {
+  const index = buildIvf(sources(), scoreRows, { nlist: 7 });
+  const q = randomRows(1, DIM, 99);
+  assertEquals(probeLists(index, q, 3, scoreRows).length, 3);
+  assertEquals(probeLists(index, q, 7, scoreRows).sort(), [0, 1, 2, 3, 4, 5, 6]);
+});
+
+Deno.test("writeIvf / readIvf round-trip", async () => {
+  await withTempDir(async (dir) => {
+    const index = buildIvf(sources(), scoreRows, { nlist: 7 });
+    const path = join(dir, "index.ivf");
+    await writeIvf(path, index);
+    assertEquals(await readIvf(path), index);
+  });
+});
+
+Deno.test("readIvf rejects other files", async () => {
+  await withTempDir(async (dir) => {
+    const path = join(dir, "index.ivf");
+    await Deno.writeTextFile(path, "not an index");
+    await assertRejects(() => readIvf(path), Error, "Not a Tieto IVF index");
+  });
+});
@@ -0,0 +1,218 @@
+/**
+ * Scoring kernels for Tieto.
+ *
+ * Everything here works on rows of one contiguous Float32Array (see
+ * store.ts) rather than on separate number[] embeddings, so a scan is a
+ * straight walk over memory with no allocation.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+// L2 norm of one row
+export function rowNorm(m: Float32Array, offset: number, dim: number): number {
+  let s = 0;
+  for (let i = 0; i < dim; i++) {
+    const v = m[offset + i];
+    s += v * v;
+  }
+  return Math.sqrt(s);
+}
+
+// L2 norm of every row; stored at ingest so queries never recompute them
+export function computeNorms(m: Float32Array, dim: number, count: number): Float32Array {
+  const norms = new Float32Array(count);
+  for (let r = 0; r < count; r++) norms[r] = rowNorm(m, r * dim, dim);
+  return norms;
+}
+
+// One pass over a row that yields both the dot product (for cosine
+// similarity, the steam shovel) and the squared difference (for Euclidean
+// distance, the sifter). Results land in out[0] and out[1] so the hot loop
+// doesn't allocate.
+export function dotAndSqDist(
+  m: Float32Array,
+  offset: number,
+  q: Float32Array,
+  dim: number,
+  out: Float64Array,
+): void {
+  let dot0 = 0, dot1 = 0, sq0 = 0, sq1 = 0;
+  let i = 0;
+  for (; i + 1 < dim; i += 2) {
+    const a0 = m[offset + i], b0 = q[i];
+    const a1 = m[offset + i + 1], b1 = q[i + 1];
+    dot0 += a0 * b0;
+    dot1 += a1 * b1;
+    const d0 = a0 - b0, d1 = a1 - b1;
+    sq0 += d0 * d0;
+    sq1 += d1 * d1;
+  }
+  if (i < dim) {
+    const a = m[offset + i], b = q[i];
+    dot0 += a * b;
+    sq0 += (a - b) * (a - b);
+  }
+  out[0] = dot0 + dot1;
+  out[1] = sq0 + sq1;
+}
+
+// cosine similarity from a dot product and the two norms
+export function cosineFromDot(dot: number, na: number, nb: number): number {
+  const denom = na * nb;
+  return denom === 0 ? 0 : dot / denom;
+}
+
+// Score `count` rows of `m` against `q` into dots[] / sqDists[]. With
+// `rows`, the i-th scored row is m row rows[i] (a filtered subset);
+// otherwise it's row i. simd.ts provides a drop-in WASM version.
+export type RowScorer = (
+  m: Float32Array,
+  dim: number,
+  count: number,
+  q: Float32Array,
+  dots: Float32Array,
+  sqDists: Float32Array,
+  rows?: Uint32Array,
+) => void;
+
+export const scoreRows: RowScorer = (m, dim, count, q, dots, sqDists, rows) => {
+  const pair = new Float64Array(2);
+  for (let i = 0; i < count; i++) {
+    const r = rows ? rows[i] : i;
+    dotAndSqDist(m, r * dim, q, dim, pair);
+    dots[i] = pair[0];
+    sqDists[i] = pair[1];
+  }
+};
+
+// Dot products of rows[r0..r1) of `m` with queries [q0..q1) of the packed
+// query matrix `qs`: row i, query j lands in out[(i - r0) * stride + j - q0].
+// simd.ts provides a WASM version.
+export type BlockScorer = (
+  m: Float32Array,
+  dim: number,
+  rows: Uint32Array,
+  r0: number,
+  r1: number,
+  qs: Float32Array,
+  q0: number,
+  q1: number,
+  out: Float64Array,
+  stride: number,
+) => void;
+
+// BlockScorer in plain JS. Queries are taken four at a time, so each row
+// element is loaded once per four products instead of once per product.
+export const dotBlock: BlockScorer = (m, dim, rows, r0, r1, qs, q0, q1, out, stride) => {
+  for (let i = r0; i < r1; i++) {
+    const off = rows[i] * dim;
+    const o = (i - r0) * stride - q0;
+    let j = q0;
+    for (; j + 3 < q1; j += 4) {
+      const b0 = j * dim, b1 = b0 + dim, b2 = b1 + dim, b3 = b2 + dim;
+      let d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+      for (let d = 0; d < dim; d++) {
+        const a = m[off + d];
+        d0 += a * qs[b0 + d];
+        d1 += a * qs[b1 + d];
+        d2 += a * qs[b2 + d];
+        d3 += a * qs[b3 + d];
+      }
+      out[o + j] = d0;
+      out[o + j + 1] = d1;
+      out[o + j + 2] = d2;
+      out[o + j + 3] = d3;
+    }
+    for (; j < q1; j++) {
+      const b = j * dim;
+      let dot = 0;
+      for (let d = 0; d < dim; d++) dot += m[off + d] * qs[b + d];
+      out[o + j] = dot;
+    }
+  }
+};
+
+// Fixed-size min-heap holding the k best (score, segment, row) entries seen
+// so far. The weakest survivor sits at the root, so each push is one
+// compare for the common case and O(log k) otherwise, and nothing is
+// allocated per candidate.
+export class TopK {
+  readonly k: number;
+  size = 0;
+  private scores: Float64Array;
+  private segs: Int32Array;
+  private rows: Int32Array;
+  private extras: Float64Array;
+
+  constructor(k: number) {
+    this.k = Math.max(0, k);
+    this.scores = new Float64Array(this.k);
+    this.segs = new Int32Array(this.k);
+    this.rows = new Int32Array(this.k);
+    this.extras = new Float64Array(this.k);
+  }
+
+  // lowest score that still gets in, or -Infinity while not full
+  get floor(): number {
+    return this.size < this.k ? -Infinity : this.scores[0];
+  }
+
+  // `extra` rides along with the entry (search keeps the squared distance)
+  push(score: number, seg: number, row: number, extra = 0): void {
+    if (this.k === 0) return;
+    if (this.size < this.k) {
+      let i = this.size++;
+      // sift up
+      while (i > 0) {
+        const parent = (i - 1) >> 1;
+        if (this.scores[parent] <= score) break;
+        this.move(parent, i);
+        i = parent;
+      }
+      this.put(i, score, seg, row, extra);
+      return;
+    }
+    if (score <= this.scores[0]) return;
+    // replace the root and sift down
+    let i = 0;
+    for (;;) {
+      const l = 2 * i + 1;
+      if (l >= this.size) break;
+      const r = l + 1;
+      const c = r < this.size && this.scores[r] < this.scores[l] ? r : l;
+      if (this.scores[c] >= score) break;
+      this.move(c, i);
+      i = c;
+    }
+    this.put(i, score, seg, row, extra);
+  }
+
+  // entries best-first
+  sorted(): { score: number; seg: number; row: number; extra: number }[] {
+    const out = [];
+    for (let i = 0; i < this.size; i++) {
+      out.push({
+        score: this.scores[i],
+        seg: this.segs[i],
+        row: this.rows[i],
+        extra: this.extras[i],
+      });
+    }
+    return out.sort((a, b) => b.score - a.score);
+  }
+
+  private move(from: number, to: number): void {
+    this.scores[to] = this.scores[from];
+    this.segs[to] = this.segs[from];
+    this.rows[to] = this.rows[from];
+    this.extras[to] = this.extras[from];
+  }
+
+  private put(i: number, score: number, seg: number, row: number, extra: number): void {
+    this.scores[i] = score;
+    this.segs[i] = seg;
+    this.rows[i] = row;
+    this.extras[i] = extra;
+  }
+}
@@ -0,0 +1,52 @@
+/**
+ * Tiny concurrency limiter: at most `n` of the wrapped tasks run at once,
+ * the rest wait their turn in FIFO order.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+export type Limiter = <T>(task: () => Promise<T>) => Promise<T>;
+
+// Waits for a free slot and resolves to the function that gives it back
+// (calling that more than once is harmless). For work whose end isn't a
+// promise, e.g. a response body someone else reads.
+export type Slots = () => Promise<() => void>;
+
+export function createSlots(n: number): Slots {
+  const max = Math.max(1, n);
+  let active = 0;
+  const waiting: (() => void)[] = [];
+
+  const releaser = () => {
+    let released = false;
+    return () => {
+      if (released) return;
+      released = true;
+      // handed straight to the next in line, so nobody can cut in
+      const next = waiting.shift();
+      if (next) next();
+      else active--;
+    };
+  };
+
+  return () => {
+    if (active < max) {
+      active++;
+      return Promise.resolve(releaser());
+    }
+    return new Promise((resolve) => waiting.push(() => resolve(releaser())));
+  };
+}
+
+export function createLimiter(n: number): Limiter {
+  const slots = createSlots(n);
+  return async <T>(task: () => Promise<T>): Promise<T> => {
+    const release = await slots();
+    try {
+      return await task();
+    } finally {
+      release();
+    }
+  };
+}
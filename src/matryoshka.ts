@@ -0,0 +1,44 @@
+/**
+ * Matryoshka coarse scans for Tieto.
+ *
+ * Embedding models trained Matryoshka-style (Nomic Embed, OpenAI's
+ * text-embedding-3, mxbai) pack the most information into the leading
+ * dimensions, so the first 64–256 of them, taken on their own, are a usable
+ * embedding. With `prefixDims` set, each resident full-precision segment
+ * gets a contiguous copy of just those leading dimensions plus their norms.
+ * Search scores every candidate row on the copy, keeps the best
+ * rescoreFactor * maxResults, and only those are scored against the full
+ * vectors and go through the similarity / distance sieve.
+ *
+ * The copy is derived when a segment is loaded and never written to disk;
+ * it costs prefixDims / dim extra memory (a sixth at 128 of 768). Models
+ * that weren't trained this way lose recall here: leave it off for them.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { computeNorms } from "./kernels.ts";
+
+export interface PrefixRows {
+  // leading dimensions kept per row
+  dim: number;
+  // count * dim floats, row-major
+  vectors: Float32Array;
+  // L2 norm of each prefix (not of the whole row)
+  norms: Float32Array;
+}
+
+// The first `keep` dimensions of every row of `m`, packed contiguously
+export function truncateRows(
+  m: Float32Array,
+  dim: number,
+  count: number,
+  keep: number,
+): PrefixRows {
+  const vectors = new Float32Array(count * keep);
+  for (let r = 0; r < count; r++) {
+    vectors.set(m.subarray(r * dim, r * dim + keep), r * keep);
+  }
+  return { dim: keep, vectors, norms: computeNorms(vectors, keep, count) };
+}
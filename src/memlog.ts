@@ -0,0 +1,279 @@
+/**
+ * Append-only memory log for Tieto: the write path behind remember().
+ *
+ * Each remembered text is one JSONL record ({text, embedding, meta}, the
+ * same shape as a .jsonl segment) appended to {topic}/{memory}/remembered.log.
+ * The first line is a header, {"generation": n}, with a random number
+ * naming this incarnation of the file (logs from before it have none and
+ * count as generation 0).
+ *
+ *   - MemoryLog batches appends: records queued within `flushMs` of each
+ *     other go out as one write and one fdatasync, and every remember()
+ *     in the batch resolves once it's durable.
+ *   - LogTail is the read side. It remembers how many bytes of the log it
+ *     has parsed and only reads what was appended since, so a resident
+ *     topic sees new records without reloading anything.
+ *
+ * Compaction (see Tieto.compactMemory()) folds the log into the binary
+ * `remembered` segment next to it. The segment's sidecar records the log's
+ * generation and how many bytes of it were folded in (a LogMark), and
+ * since the sidecar is renamed into place last, that is the commit point:
+ * from then on LogTail skips those bytes. Only then is the log replaced by
+ * an empty one under a new generation, which LogTail notices by its
+ * header and starts over on. A crash in between leaves records in the log
+ * that are skipped, never counted twice.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { dirname } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { rowNorm } from "./kernels.ts";
+import { DocTable, JsonlRecord, LogMark, Segment, writeAtomic } from "./store.ts";
+
+const HEADER_PREFIX = '{"generation":';
+
+function logHeader(generation: number): Uint8Array {
+  return new TextEncoder().encode(JSON.stringify({ generation }) + "\n");
+}
+
+// generation and length of a log's header line; 0 and 0 for a log with
+// none (older versions, or an empty file)
+async function readHeader(file: Deno.FsFile, size: number) {
+  const bytes = new Uint8Array(Math.min(size, 64));
+  await file.seek(0, Deno.SeekMode.Start);
+  for (let got = 0; got < bytes.length;) {
+    const n = await file.read(bytes.subarray(got));
+    if (n === null) break;
+    got += n;
+  }
+  const line = new TextDecoder().decode(bytes.subarray(0, bytes.indexOf(0x0a) + 1));
+  if (!line.startsWith(HEADER_PREFIX)) return { generation: 0, start: 0 };
+  return { generation: Number(JSON.parse(line).generation), start: line.length };
+}
+
+interface Pending {
+  bytes: Uint8Array;
+  resolve: () => void;
+  reject: (e: unknown) => void;
+}
+
+export class MemoryLog {
+  readonly path: string;
+  private flushMs: number;
+  private queue: Pending[] = [];
+  private timer?: number;
+  // flushes and exclusive() work run one after another on this chain
+  private tail: Promise<void> = Promise.resolve();
+  // the directory exists (the topic may be brand new)
+  private ready = false;
+
+  constructor(path: string, flushMs: number) {
+    this.path = path;
+    this.flushMs = flushMs;
+  }
+
+  // Append one record; resolves once it has been synced to disk
+  append(record: JsonlRecord): Promise<void> {
+    const bytes = new TextEncoder().encode(JSON.stringify(record) + "\n");
+    return new Promise((resolve, reject) => {
+      this.queue.push({ bytes, resolve, reject });
+      this.timer ??= setTimeout(() => {
+        this.timer = undefined;
+        this.tail = this.tail.then(() => this.flush());
+      }, this.flushMs);
+    });
+  }
+
+  // bytes in the log, once what's being flushed is on disk
+  async bytes(): Promise<number> {
+    await this.tail;
+    try {
+      return (await Deno.stat(this.path)).size;
+    } catch (e) {
+      if (e instanceof Deno.errors.NotFound) return 0;
+      throw e;
+    }
+  }
+
+  private async flush(): Promise<void> {
+    const batch = this.queue;
+    this.queue = [];
+    if (!batch.length) return;
+    try {
+      if (!this.ready) {
+        await Deno.mkdir(dirname(this.path), { recursive: true });
+        this.ready = true;
+      }
+      const file = await Deno.open(this.path, { append: true, create: true });
+      try {
+        // a brand new log starts with its header
+        const header = (await file.stat()).size ? null : logHeader(newGeneration());
+        const total = (header?.length ?? 0) + batch.reduce((n, p) => n + p.bytes.length, 0);
+        const out = new Uint8Array(total);
+        let at = 0;
+        if (header) {
+          out.set(header);
+          at = header.length;
+        }
+        for (const p of batch) {
+          out.set(p.bytes, at);
+          at += p.bytes.length;
+        }
+        for (let written = 0; written < total;) {
+          written += await file.write(out.subarray(written));
+        }
+        await file.syncData();
+      } finally {
+        file.close();
+      }
+      for (const p of batch) p.resolve();
+    } catch (e) {
+      for (const p of batch) p.reject(e);
+    }
+  }
+
+  // Run `work` with no flush in progress; appends made meanwhile wait and
+  // go out afterwards
+  exclusive<T>(work: () => Promise<T>): Promise<T> {
+    const run = this.tail.then(work);
+    this.tail = run.then(() => {}, () => {});
+    return run;
+  }
+
+  // Replace the log with an empty one under a new generation, in one
+  // rename. Only from exclusive() work, once whatever was in it is safe
+  // elsewhere.
+  async restart(): Promise<void> {
+    await writeAtomic(this.path, logHeader(newGeneration()));
+  }
+}
+
+function newGeneration(): number {
+  // never 0, which is what a log without a header counts as
+  return crypto.getRandomValues(new Uint32Array(1))[0] || 1;
+}
+
+// Read side of a log: a resident segment that grows as the file does
+export class LogTail {
+  private generation = 0;
+  // where parsing started: past the header, and past whatever a
+  // compacted segment already holds
+  private from = 0;
+  private offset = 0;
+  private dim = 0;
+  private count = 0;
+  private vectors = new Float32Array(0);
+  private norms = new Float32Array(0);
+  private texts: string[] = [];
+  private table = new DocTable();
+  private docOf = new Uint32Array(0);
+  private view?: Segment;
+
+  // bytes of the log parsed so far
+  get bytes(): number {
+    return this.offset;
+  }
+
+  // how far into which log this tail has read, for a segment that takes
+  // its records over
+  get mark(): LogMark {
+    return { generation: this.generation, offset: this.offset };
+  }
+
+  private reset(generation: number, from: number): void {
+    this.generation = generation;
+    this.from = this.offset = from;
+    this.dim = this.count = 0;
+    this.vectors = new Float32Array(0);
+    this.norms = new Float32Array(0);
+    this.texts = [];
+    this.table = new DocTable();
+    this.docOf = new Uint32Array(0);
+    this.view = undefined;
+  }
+
+  private push(c: JsonlRecord): void {
+    if (!this.dim) this.dim = c.embedding.length;
+    if (c.embedding.length !== this.dim) {
+      throw new Error("Vectors must have the same dimension.");
+    }
+    // capacity doubles, so appends are amortized O(1)
+    if ((this.count + 1) * this.dim > this.vectors.length) {
+      const rows = Math.max(64, this.count * 2);
+      const vectors = new Float32Array(rows * this.dim);
+      vectors.set(this.vectors);
+      this.vectors = vectors;
+      const norms = new Float32Array(rows);
+      norms.set(this.norms);
+      this.norms = norms;
+      const docOf = new Uint32Array(rows);
+      docOf.set(this.docOf);
+      this.docOf = docOf;
+    }
+    this.vectors.set(c.embedding, this.count * this.dim);
+    this.norms[this.count] = rowNorm(this.vectors, this.count * this.dim, this.dim);
+    this.texts.push(c.text);
+    this.docOf[this.count] = this.table.addRecord(c);
+    this.count++;
+  }
+
+  // The log as a segment, reading only what was appended since last time,
+  // and none of what `compacted` (the mark of the segment the log is
+  // compacted into) says is in there already. Returns the same object
+  // while nothing changed, a new one otherwise (so per-segment caches
+  // keyed on it start fresh).
+  async refresh(path: string, compacted?: LogMark): Promise<Segment> {
+    const file = await Deno.open(path, { read: true });
+    let bytes = new Uint8Array(0);
+    try {
+      const { size } = await file.stat();
+      const { generation, start } = await readHeader(file, size);
+      const from = compacted?.generation === generation
+        ? Math.max(start, compacted.offset)
+        : start;
+      // a new log (compaction replaced it), more of this one compacted, or
+      // one that shrank under us (truncated by an older version): start over
+      if (generation !== this.generation || from !== this.from || size < this.offset) {
+        this.reset(generation, from);
+      }
+
+      if (size > this.offset) {
+        await file.seek(this.offset, Deno.SeekMode.Start);
+        bytes = new Uint8Array(size - this.offset);
+        for (let got = 0; got < bytes.length;) {
+          const n = await file.read(bytes.subarray(got));
+          if (n === null) {
+            bytes = bytes.subarray(0, got);
+            break;
+          }
+          got += n;
+        }
+      }
+    } finally {
+      file.close();
+    }
+
+    if (bytes.length) {
+      // only whole lines; a record still being written waits for next time
+      const end = bytes.lastIndexOf(0x0a) + 1;
+      const text = new TextDecoder().decode(bytes.subarray(0, end));
+      for (const line of text.split("\n")) {
+        if (line.trim()) this.push(JSON.parse(line));
+      }
+      this.offset += end;
+      if (end) this.view = undefined;
+    }
+
+    this.view ??= {
+      dim: this.dim,
+      count: this.count,
+      vectors: this.vectors.subarray(0, this.count * this.dim),
+      norms: this.norms.subarray(0, this.count),
+      texts: this.texts.slice(),
+      docs: this.table.docs.slice(),
+      docOf: this.docOf.subarray(0, this.count),
+    };
+    return this.view;
+  }
+}
@@ -0,0 +1,155 @@
+/**
+ * Tests for the memory log (memlog.ts) and its compaction.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import {
+  assert,
+  assertEquals,
+  assertStrictEquals,
+} from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { LogTail, MemoryLog } from "./memlog.ts";
+import { metaOf, readSegment, readTexts } from "./store.ts";
+import { Tieto } from "./tieto.class.ts";
+import { withTempDir } from "./test_util.ts";
+
+const record = (i: number) => ({ text: `fact ${i}`, embedding: [i, 1, 0, 2], meta: { n: i } });
+
+Deno.test("appends close together share a flush and are all durable", async () => {
+  await withTempDir(async (dir) => {
+    const log = new MemoryLog(join(dir, "new", "topic", "remembered.log"), 10);
+    await Promise.all([0, 1, 2, 3].map((i) => log.append(record(i))));
+    const [header, ...lines] = (await Deno.readTextFile(log.path)).trimEnd().split("\n");
+    assert(JSON.parse(header).generation > 0);
+    assertEquals(lines.map((l) => JSON.parse(l)), [0, 1, 2, 3].map(record));
+    assertEquals(await log.bytes(), (await Deno.stat(log.path)).size);
+  });
+});
+
+Deno.test("LogTail reads only what was appended", async () => {
+  await withTempDir(async (dir) => {
+    const log = new MemoryLog(join(dir, "remembered.log"), 0);
+    const tail = new LogTail();
+    await log.append(record(1));
+    const first = await tail.refresh(log.path);
+    assertEquals(first.count, 1);
+    assertEquals(Array.from(first.vectors!), [1, 1, 0, 2]);
+    // nothing new: the very same segment
+    assertStrictEquals(await tail.refresh(log.path), first);
+
+    await log.append(record(2));
+    const second = await tail.refresh(log.path);
+    assert(second !== first);
+    assertEquals(second.texts, ["fact 1", "fact 2"]);
+    assertEquals(second.docs, [{ n: 1 }, { n: 2 }]);
+    assertEquals(Array.from(second.docOf), [0, 1]);
+    assertEquals(first.count, 1);
+  });
+});
+
+Deno.test("LogTail waits for a record's line to be finished", async () => {
+  await withTempDir(async (dir) => {
+    const path = join(dir, "remembered.log");
+    const line = JSON.stringify(record(5));
+    await Deno.writeTextFile(path, line.slice(0, 10));
+    const tail = new LogTail();
+    assertEquals((await tail.refresh(path)).count, 0);
+    await Deno.writeTextFile(path, line.slice(10) + "\n", { append: true });
+    assertEquals((await tail.refresh(path)).texts, ["fact 5"]);
+  });
+});
+
+Deno.test("LogTail starts over when the log is truncated", async () => {
+  await withTempDir(async (dir) => {
+    const log = new MemoryLog(join(dir, "remembered.log"), 0);
+    const tail = new LogTail();
+    await log.append(record(1));
+    await log.append(record(2));
+    assertEquals((await tail.refresh(log.path)).count, 2);
+    await Deno.truncate(log.path);
+    await log.append(record(3));
+    assertEquals((await tail.refresh(log.path)).texts, ["fact 3"]);
+  });
+});
+
+Deno.test("LogTail starts over on a restarted log, however long it is", async () => {
+  await withTempDir(async (dir) => {
+    const log = new MemoryLog(join(dir, "remembered.log"), 0);
+    const tail = new LogTail();
+    await log.append(record(1));
+    assertEquals((await tail.refresh(log.path)).count, 1);
+    await log.exclusive(() => log.restart());
+    for (const i of [2, 3]) await log.append(record(i));
+    assertEquals((await tail.refresh(log.path)).texts, ["fact 2", "fact 3"]);
+  });
+});
+
+Deno.test("LogTail skips what a compacted segment already holds", async () => {
+  await withTempDir(async (dir) => {
+    const log = new MemoryLog(join(dir, "remembered.log"), 0);
+    for (const i of [1, 2]) await log.append(record(i));
+    const tail = new LogTail();
+    await tail.refresh(log.path);
+    const mark = tail.mark;
+    await log.append(record(3));
+
+    assertEquals((await new LogTail().refresh(log.path, mark)).texts, ["fact 3"]);
+    // a mark from another generation of the log says nothing about this one
+    const other = { generation: mark.generation + 1, offset: mark.offset };
+    assertEquals((await new LogTail().refresh(log.path, other)).count, 3);
+    // and a tail that has read everything drops what got compacted
+    assertEquals((await tail.refresh(log.path, mark)).texts, ["fact 3"]);
+  });
+});
+
+Deno.test("compactMemory folds the log into the remembered segment", async () => {
+  await withTempDir(async (dir) => {
+    const tieto = new Tieto({ topicsDirectory: dir });
+    const base = join(dir, "notes", "memory", "remembered");
+    const log = new MemoryLog(`${base}.log`, 0);
+    for (const i of [1, 2, 3]) await log.append(record(i));
+
+    await tieto.compactMemory("notes");
+    const texts = await readTexts(await readSegment(base), [0, 1, 2]);
+    assertEquals(texts, ["fact 1", "fact 2", "fact 3"]);
+    assertEquals((await new LogTail().refresh(`${base}.log`)).count, 0);
+
+    // a second round appends to what's there; an empty log changes nothing
+    for (const i of [4, 5]) await log.append(record(i));
+    await tieto.compactMemory("notes");
+    await tieto.compactMemory("notes");
+    const seg = await readSegment(base);
+    assertEquals(seg.count, 5);
+    assertEquals(Array.from({ length: seg.count }, (_, r) => metaOf(seg, r).n), [1, 2, 3, 4, 5]);
+    assertEquals(Array.from(seg.vectors!.subarray(16, 20)), [5, 1, 0, 2]);
+  });
+});
+
+Deno.test("a compaction cut short before the log restarts counts nothing twice", async () => {
+  await withTempDir(async (dir) => {
+    const tieto = new Tieto({ topicsDirectory: dir });
+    const base = join(dir, "notes", "memory", "remembered");
+    const log = new MemoryLog(`${base}.log`, 0);
+    for (const i of [1, 2, 3]) await log.append(record(i));
+    const before = await Deno.readFile(`${base}.log`);
+
+    // the segment is written, then the process dies: the log is as it was
+    await tieto.compactMemory("notes");
+    await Deno.writeFile(`${base}.log`, before);
+    const seg = await readSegment(base);
+    assertEquals((await new LogTail().refresh(`${base}.log`, seg.log)).count, 0);
+
+    // the next run has nothing to add and only finishes the restart
+    await tieto.compactMemory("notes");
+    assertEquals((await readSegment(base)).count, 3);
+    assertEquals((await new LogTail().refresh(`${base}.log`)).count, 0);
+    await log.append(record(4));
+    await tieto.compactMemory("notes");
+    const after = await readSegment(base);
+    assertEquals(Array.from({ length: after.count }, (_, r) => metaOf(after, r).n), [1, 2, 3, 4]);
+    assertEquals((await new LogTail().refresh(`${base}.log`, after.log)).count, 0);
+  });
+});
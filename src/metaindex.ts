@@ -0,0 +1,198 @@
+/**
+ * Per-segment metadata index for Tieto.
+ *
+ * Built once when a segment is loaded, from the frontmatter of its
+ * documents (a segment stores each document's metadata once, see store.ts):
+ *
+ *   - postings: key → value string → docs, answering `=` and `in`
+ *   - columns:  key → docs sorted by numeric / date value (parsed once,
+ *               to epoch ms for dates), answering >=, <=, >, <
+ *
+ * select() turns a compiled filter (see filters.ts) into the sorted set of
+ * rows that pass, before any vector is touched. The filter is evaluated per
+ * document: AND intersects, OR unions and NOT complements the doc sets of
+ * its parts, and the documents that pass are then expanded to their rows.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { Compiled, metaNumber, metaString } from "./filters.ts";
+
+interface Column {
+  // ascending
+  values: Float64Array;
+  docs: Uint32Array;
+}
+
+const EMPTY = new Uint32Array(0);
+
+// rows present in both (sorted) sets
+export function intersectRows(a: Uint32Array, b: Uint32Array): Uint32Array {
+  const out = new Uint32Array(Math.min(a.length, b.length));
+  let i = 0, j = 0, n = 0;
+  while (i < a.length && j < b.length) {
+    if (a[i] < b[j]) i++;
+    else if (a[i] > b[j]) j++;
+    else {
+      out[n++] = a[i];
+      i++;
+      j++;
+    }
+  }
+  return out.subarray(0, n);
+}
+
+// rows in either (sorted) set
+function unionRows(a: Uint32Array, b: Uint32Array): Uint32Array {
+  const out = new Uint32Array(a.length + b.length);
+  let i = 0, j = 0, n = 0;
+  while (i < a.length || j < b.length) {
+    if (j >= b.length || (i < a.length && a[i] < b[j])) out[n++] = a[i++];
+    else if (i >= a.length || b[j] < a[i]) out[n++] = b[j++];
+    else {
+      out[n++] = a[i];
+      i++;
+      j++;
+    }
+  }
+  return out.subarray(0, n);
+}
+
+// first index in `values` whose value is >= x (or > x when `strict`)
+function lowerBound(values: Float64Array, x: number, strict: boolean): number {
+  let lo = 0, hi = values.length;
+  while (lo < hi) {
+    const mid = (lo + hi) >>> 1;
+    if (strict ? values[mid] <= x : values[mid] < x) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+export class MetaIndex {
+  // documents; postings and columns hold doc ids
+  readonly count: number;
+  private docOf: Uint32Array;
+  // row r belongs to doc r, so doc sets are already row sets
+  private oneRowEach: boolean;
+  private postings = new Map<string, Map<string, Uint32Array>>();
+  private columns = new Map<string, Column>();
+
+  constructor(docs: Record<string, unknown>[], docOf: Uint32Array) {
+    this.count = docs.length;
+    this.docOf = docOf;
+    this.oneRowEach = docOf.length === docs.length && docOf.every((d, r) => d === r);
+    const postings = new Map<string, Map<string, number[]>>();
+    const columns = new Map<string, [number, number][]>();
+
+    docs.forEach((meta, doc) => {
+      for (const key in meta) {
+        const str = metaString(meta[key]);
+        if (str === null) continue;
+
+        let byValue = postings.get(key);
+        if (!byValue) postings.set(key, byValue = new Map());
+        const ids = byValue.get(str);
+        if (ids) ids.push(doc);
+        else byValue.set(str, [doc]);
+
+        const num = metaNumber(str);
+        if (isNaN(num)) continue;
+        let column = columns.get(key);
+        if (!column) columns.set(key, column = []);
+        column.push([num, doc]);
+      }
+    });
+
+    for (const [key, byValue] of postings) {
+      const packed = new Map<string, Uint32Array>();
+      for (const [value, ids] of byValue) packed.set(value, Uint32Array.from(ids));
+      this.postings.set(key, packed);
+    }
+    for (const [key, pairs] of columns) {
+      pairs.sort((a, b) => a[0] - b[0]);
+      this.columns.set(key, {
+        values: Float64Array.from(pairs, (p) => p[0]),
+        docs: Uint32Array.from(pairs, (p) => p[1]),
+      });
+    }
+  }
+
+  // all docs, 0..count-1
+  private everything(): Uint32Array {
+    return Uint32Array.from({ length: this.count }, (_, i) => i);
+  }
+
+  // docs not in the (sorted) set
+  private complement(rows: Uint32Array): Uint32Array {
+    const out = new Uint32Array(this.count - rows.length);
+    let n = 0, j = 0;
+    for (let r = 0; r < this.count; r++) {
+      if (j < rows.length && rows[j] === r) j++;
+      else out[n++] = r;
+    }
+    return out;
+  }
+
+  // Sorted rows passing a compiled filter (see compileFilters())
+  select(c: Compiled): Uint32Array {
+    const docs = this.selectDocs(c);
+    if (this.oneRowEach || !docs.length) return docs;
+    const rows = this.docOf.length;
+    if (docs.length === this.count) return Uint32Array.from({ length: rows }, (_, i) => i);
+
+    const pass = new Uint8Array(this.count);
+    for (const d of docs) pass[d] = 1;
+    let n = 0;
+    for (let r = 0; r < rows; r++) n += pass[this.docOf[r]];
+    const out = new Uint32Array(n);
+    for (let r = 0, i = 0; r < rows; r++) if (pass[this.docOf[r]]) out[i++] = r;
+    return out;
+  }
+
+  // sorted docs passing a compiled filter
+  private selectDocs(c: Compiled): Uint32Array {
+    switch (c.kind) {
+      case "never":
+        return EMPTY;
+      case "eq":
+        return this.postings.get(c.key)?.get(c.value) ?? EMPTY;
+      case "in": {
+        const byValue = this.postings.get(c.key);
+        if (!byValue) return EMPTY;
+        let out = EMPTY;
+        for (const value of c.values) {
+          const rows = byValue.get(value);
+          if (rows) out = unionRows(out, rows);
+        }
+        return out;
+      }
+      case "range": {
+        const column = this.columns.get(c.key);
+        if (!column) return EMPTY;
+        const { values, docs } = column;
+        // the column is sorted, so every range op is one contiguous slice
+        let from = 0, to = values.length;
+        if (c.op === ">=") from = lowerBound(values, c.right, false);
+        else if (c.op === ">") from = lowerBound(values, c.right, true);
+        else if (c.op === "<=") to = lowerBound(values, c.right, true);
+        else to = lowerBound(values, c.right, false);
+        return docs.slice(from, to).sort();
+      }
+      case "not":
+        return this.complement(this.selectDocs(c.part));
+      case "any":
+        return c.parts.reduce((out, part) => unionRows(out, this.selectDocs(part)), EMPTY);
+      case "all": {
+        if (!c.parts.length) return this.everything();
+        // narrowest set first, so the intersections only get smaller
+        const sets = c.parts.map((part) => this.selectDocs(part))
+          .sort((a, b) => a.length - b.length);
+        let out = sets[0];
+        for (let i = 1; i < sets.length && out.length; i++) out = intersectRows(out, sets[i]);
+        return out;
+      }
+    }
+  }
+}
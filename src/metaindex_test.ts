@@ -0,0 +1,119 @@
+/**
+ * Tests for the per-segment metadata index (metaindex.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assertEquals } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { compileFilters, FilterExpr } from "./filters.ts";
+import { intersectRows, MetaIndex } from "./metaindex.ts";
+import { DocTable } from "./store.ts";
+
+const metas: Record<string, unknown>[] = [
+  { tag: "a", weight: 3, date: "2024-01-05" },
+  { tag: "b", weight: 10, date: "2024-03-01" },
+  { tag: ["a", "b"], weight: "7" },
+  { weight: 1, date: "2023-12-31" },
+  { tag: "c", date: "not a date" },
+];
+
+// an index over one row per object in `metas`
+function indexOf(metas: Record<string, unknown>[]): MetaIndex {
+  const docs = new DocTable();
+  const docOf = Uint32Array.from(metas, (meta) => docs.add(meta));
+  return new MetaIndex(docs.docs, docOf);
+}
+
+const rows = (filters: FilterExpr[]) => Array.from(indexOf(metas).select(compileFilters(filters)));
+
+Deno.test("= and in match the string form of the value", () => {
+  assertEquals(rows([{ key: "tag", op: "=", value: "a" }]), [0]);
+  assertEquals(rows([{ key: "tag", op: "=", value: "a,b" }]), [2]);
+  assertEquals(rows([{ key: "weight", op: "=", value: "7" }]), [2]);
+  assertEquals(rows([{ key: "tag", op: "in", value: "b,c" }]), [1, 4]);
+  assertEquals(rows([{ key: "tag", op: "in", value: ["a", "c"] }]), [0, 4]);
+});
+
+Deno.test("numeric and date ranges", () => {
+  assertEquals(rows([{ key: "weight", op: ">=", value: "7" }]), [1, 2]);
+  assertEquals(rows([{ key: "weight", op: ">", value: "7" }]), [1]);
+  assertEquals(rows([{ key: "weight", op: "<", value: "3" }]), [3]);
+  assertEquals(rows([{ key: "date", op: ">=", value: "2024-01-01" }]), [0, 1]);
+  // unparseable on either side never matches
+  assertEquals(rows([{ key: "date", op: "<", value: "soon" }]), []);
+});
+
+Deno.test("filters are AND-ed and a missing key matches nothing", () => {
+  assertEquals(
+    rows([{ key: "weight", op: ">=", value: "3" }, { key: "date", op: "<", value: "2024-02-01" }]),
+    [0],
+  );
+  assertEquals(rows([{ key: "colour", op: "=", value: "red" }]), []);
+  assertEquals(rows([]), [0, 1, 2, 3, 4]);
+});
+
+Deno.test("any and not groups", () => {
+  const either: FilterExpr = {
+    any: [{ key: "tag", op: "=", value: "c" }, { key: "weight", op: "<", value: "2" }],
+  };
+  assertEquals(rows([either]), [3, 4]);
+  // not covers rows without the key too
+  assertEquals(rows([{ not: { key: "tag", op: "in", value: "a,b" } }]), [2, 3, 4]);
+});
+
+Deno.test("select agrees with the compiled per-chunk test", () => {
+  let seed = 7;
+  const next = () => (seed = (seed * 1103515245 + 12345) >>> 0) % 1000;
+  // 40 documents, 400 rows among them
+  const docs = Array.from({ length: 40 }, () => ({
+    tag: ["x", "y", "z"][next() % 3],
+    weight: next() % 50,
+    date: `2024-0${1 + (next() % 9)}-1${next() % 10}`,
+  } as Record<string, unknown>));
+  const docOf = Uint32Array.from({ length: 400 }, () => next() % docs.length);
+  const index = new MetaIndex(docs, docOf);
+  const cases: FilterExpr[][] = [
+    [{ key: "tag", op: "=", value: "y" }],
+    [{ key: "tag", op: "in", value: "x,z" }, { key: "weight", op: "<=", value: "20" }],
+    [{ key: "weight", op: ">", value: "10" }, { key: "date", op: "<", value: "2024-05-01" }],
+    [
+      { key: "date", op: ">=", value: "2024-03-15" },
+      { key: "date", op: "<=", value: "2024-07-01" },
+    ],
+    [{ any: [{ key: "tag", op: "=", value: "x" }, { key: "weight", op: ">=", value: "40" }] }],
+    [{ not: { key: "tag", op: "=", value: "z" } }, { key: "weight", op: "<", value: "25" }],
+    [{
+      not: {
+        any: [
+          { key: "tag", op: "in", value: "x,y" },
+          { key: "date", op: ">", value: "2024-08-01" },
+        ],
+      },
+    }],
+    [{
+      all: [
+        { key: "weight", op: ">", value: "5" },
+        { not: { key: "weight", op: ">", value: "30" } },
+      ],
+    }],
+    [{ key: "weight", op: ">", value: "soon" }],
+  ];
+  for (const filters of cases) {
+    const compiled = compileFilters(filters);
+    const expected = Array.from(docOf).flatMap((d, r) => compiled.test(docs[d]) ? [r] : []);
+    assertEquals(Array.from(index.select(compiled)), expected);
+  }
+});
+
+Deno.test("rows sharing a document are selected together", () => {
+  const index = new MetaIndex([{ tag: "a" }, { tag: "b" }], new Uint32Array([1, 0, 0, 1, 1]));
+  const select = (filters: FilterExpr[]) => Array.from(index.select(compileFilters(filters)));
+  assertEquals(select([{ key: "tag", op: "=", value: "b" }]), [0, 3, 4]);
+  assertEquals(select([{ not: { key: "tag", op: "=", value: "b" } }]), [1, 2]);
+});
+
+Deno.test("intersectRows keeps rows in both sets", () => {
+  const out = intersectRows(new Uint32Array([1, 3, 5, 9]), new Uint32Array([0, 3, 4, 9, 12]));
+  assertEquals(Array.from(out), [3, 9]);
+});
@@ -0,0 +1,99 @@
+/**
+ * Per-query metrics for Tieto.
+ *
+ * Every search / query fills in one QueryMetrics: how long each phase
+ * took, how many chunks were looked at and kept at each step, and how much
+ * was read from disk. query(…, returnRaw) returns it with the results, and
+ * the `onMetrics` config hook gets it for every query, so it can go to a
+ * log line, a Prometheus histogram or an OpenTelemetry span without
+ * turning on debug output.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+export interface QueryMetrics {
+  topics: string[];
+  // milliseconds per phase; phases a query didn't reach stay 0
+  timings: {
+    // stat / read / parse of segments and IVF indexes (0 when resident)
+    load: number;
+    // question embedding round trip (near 0 on a cache hit)
+    embed: number;
+    // IVF probing and frontmatter filtering
+    filter: number;
+    // scoring resident rows (on the workers, if they were used)
+    score: number;
+    // reading and scoring JSONL files too big to keep resident
+    stream: number;
+    // ranking the winners and building result chunks
+    sort: number;
+    // packing the prompt context (query only)
+    pack: number;
+    // completion request, to the last token when streaming (query only)
+    completion: number;
+    total: number;
+  };
+  counts: {
+    // resident segments searched, and the chunks in them
+    segments: number;
+    chunks: number;
+    // chunks left to score after IVF probing and filters
+    candidates: number;
+    // records read from streamed JSONL files
+    streamed: number;
+    // results that passed the similarity / distance thresholds
+    returned: number;
+  };
+  // bytes read from disk for this query (segments loaded, logs tailed,
+  // JSONL streamed)
+  bytesRead: number;
+  embeddingCached: boolean;
+  // scanned on the worker pool
+  parallel: boolean;
+}
+
+export type MetricsHook = (metrics: QueryMetrics) => void;
+
+export function newMetrics(topics: string[]): QueryMetrics {
+  return {
+    topics,
+    timings: {
+      load: 0,
+      embed: 0,
+      filter: 0,
+      score: 0,
+      stream: 0,
+      sort: 0,
+      pack: 0,
+      completion: 0,
+      total: 0,
+    },
+    counts: { segments: 0, chunks: 0, candidates: 0, streamed: 0, returned: 0 },
+    bytesRead: 0,
+    embeddingCached: false,
+    parallel: false,
+  };
+}
+
+// Milliseconds since the previous call (or since it was created)
+export function stopwatch(): () => number {
+  let last = performance.now();
+  return () => {
+    const now = performance.now();
+    const ms = now - last;
+    last = now;
+    return ms;
+  };
+}
+
+// one line for debug output
+export function formatMetrics(m: QueryMetrics): string {
+  const t = Object.entries(m.timings)
+    .filter(([, ms]) => ms > 0)
+    .map(([phase, ms]) => `${phase} ${ms.toFixed(1)}ms`)
+    .join(", ");
+  const c = m.counts;
+  return `${t} | ${c.candidates}/${c.chunks} chunks scored, ${c.streamed} streamed, ` +
+    `${c.returned} returned | ${m.bytesRead} bytes read`;
+}
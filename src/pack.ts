@@ -0,0 +1,142 @@
+/**
+ * Context packing for Tieto prompts.
+ *
+ * Search results arrive best-first. packContext() takes them in that order
+ * and fits as many as it can into a token budget:
+ *
+ *   - lines and sentences already in the context (the overlap between
+ *     neighbouring chunks, the same passage ingested twice) are trimmed
+ *     from the start and end of each chunk, and a chunk with nothing new
+ *     left is skipped
+ *   - the first chunk that doesn't fit is cut at the last paragraph, line
+ *     or sentence boundary that does, and packing stops there
+ *
+ * Token counts come from a caller-supplied counter: estimateTokens() by
+ * default, or a real tokenizer.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { sentenceSpans } from "./sentences.ts";
+
+export type TokenCounter = (text: string) => number | Promise<number>;
+
+// chunks shorter than this after cutting aren't worth including
+const MIN_PIECE_TOKENS = 8;
+
+// Rough token count for English-ish text without a tokenizer: BPE
+// vocabularies average about four characters, or three quarters of a
+// word, per token. Taking the larger of the two keeps dense text (code,
+// numbers, punctuation) from being undercounted.
+export function estimateTokens(text: string): number {
+  let words = 0, inWord = false;
+  for (let i = 0; i < text.length; i++) {
+    const c = text.charCodeAt(i);
+    const space = c === 32 || c === 10 || c === 9 || c === 13;
+    if (!space && !inWord) words++;
+    inWord = !space;
+  }
+  return Math.ceil(Math.max(text.length / 4, (words * 4) / 3));
+}
+
+// `line` without the sentences at its start (or end) that the context
+// already has; "" when nothing new is left
+function trimKnown(line: string, seen: Set<string>, fromStart: boolean): string {
+  if (!line.trim() || seen.has(line.trim())) return "";
+  const spans = sentenceSpans(line);
+  let from = 0, to = spans.length;
+  const known = (i: number) => seen.has(line.slice(spans[i][0], spans[i][1]));
+  if (fromStart) while (from < to && known(from)) from++;
+  else while (to > from && known(to - 1)) to--;
+  if (from === to) return "";
+  return fromStart ? line.slice(spans[from][0]) : line.slice(0, spans[to - 1][1]);
+}
+
+// the chunk without leading / trailing lines and sentences the context
+// already has
+function newPart(text: string, seen: Set<string>): string {
+  const lines = text.split("\n");
+  let from = 0, to = lines.length;
+  for (; from < to; from++) {
+    lines[from] = trimKnown(lines[from], seen, true);
+    if (lines[from]) break;
+  }
+  for (; to > from; to--) {
+    lines[to - 1] = trimKnown(lines[to - 1], seen, false);
+    if (lines[to - 1]) break;
+  }
+  return lines.slice(from, to).join("\n");
+}
+
+// lines and sentences of a packed part, for newPart()
+function remember(part: string, seen: Set<string>): void {
+  for (const line of part.split("\n")) {
+    if (!line.trim()) continue;
+    seen.add(line.trim());
+    for (const [start, end] of sentenceSpans(line)) seen.add(line.slice(start, end));
+  }
+}
+
+// where a piece may be cut; sentences keep their closing punctuation
+const BOUNDARIES: [RegExp, boolean][] = [
+  [/\n\s*\n/g, false],
+  [/\n/g, false],
+  [/[.!?]["')\]]?\s/g, true],
+  [/\s/g, false],
+];
+
+// Longest prefix of `text` ending on a boundary, at most `chars` long.
+// Paragraphs beat lines beat sentences; if there's no boundary at all the
+// prefix is cut on a space.
+function cutAt(text: string, chars: number): string {
+  const head = text.slice(0, chars);
+  for (const [boundary, after] of BOUNDARIES) {
+    let end = -1;
+    for (const m of head.matchAll(boundary)) {
+      end = after ? m.index! + m[0].length : m.index!;
+    }
+    // don't settle for a boundary that throws most of the room away
+    if (end > chars * 0.6) return head.slice(0, end).trimEnd();
+  }
+  return "";
+}
+
+// Join the best-first `texts` into a context of at most `budget` tokens
+// (0 for no limit), separated by blank lines.
+export async function packContext(
+  texts: string[],
+  budget: number,
+  count: TokenCounter,
+): Promise<string> {
+  const parts: string[] = [];
+  const seen = new Set<string>();
+  const separator = budget ? await count("\n\n") : 0;
+  let used = 0;
+
+  for (const text of texts) {
+    let part = newPart(text, seen);
+    if (!part) continue;
+
+    if (budget) {
+      const room = budget - used - (parts.length ? separator : 0);
+      let tokens = await count(part);
+      if (tokens > room) {
+        // shrink in proportion, then confirm (a few rounds at most)
+        for (let round = 0; round < 4 && part && tokens > room; round++) {
+          part = cutAt(part, Math.floor((part.length * room) / tokens * 0.95));
+          tokens = part ? await count(part) : 0;
+        }
+        if (part && tokens <= room && tokens >= MIN_PIECE_TOKENS) {
+          parts.push(part);
+        }
+        break;
+      }
+      used += tokens + (parts.length ? separator : 0);
+    }
+
+    parts.push(part);
+    remember(part, seen);
+  }
+  return parts.join("\n\n");
+}
@@ -0,0 +1,64 @@
+/**
+ * Tests for context packing (pack.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assert, assertEquals } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { estimateTokens, packContext } from "./pack.ts";
+
+// one token per word keeps the budgets below easy to follow
+const words = (text: string) => text.split(/\s+/).filter(Boolean).length;
+
+const sentence = (n: number) => `Sentence ${n} has exactly seven words here.`;
+
+Deno.test("estimateTokens takes the larger of the char and word estimates", () => {
+  assertEquals(estimateTokens(""), 0);
+  assertEquals(estimateTokens("one two three"), 4);
+  assertEquals(estimateTokens("x".repeat(30)), 8);
+});
+
+Deno.test("without a budget every chunk goes in, overlapping lines once", async () => {
+  const out = await packContext(["alpha\nbeta", "beta\ngamma", "alpha\nbeta"], 0, words);
+  assertEquals(out, "alpha\nbeta\n\ngamma");
+});
+
+Deno.test("sentences repeated by chunk overlap are packed once", async () => {
+  const left = `${sentence(1)} ${sentence(2)} ${sentence(3)}`;
+  const right = `${sentence(3)} ${sentence(4)}`;
+  const packed = await packContext([right, left], 0, words);
+  assertEquals(packed, `${right}\n\n${sentence(1)} ${sentence(2)}`);
+  assertEquals(await packContext([left, right], 0, words), `${left}\n\n${sentence(4)}`);
+});
+
+Deno.test("the context never exceeds the budget", async () => {
+  const texts = Array.from(
+    { length: 12 },
+    (_, i) => `${sentence(3 * i)} ${sentence(3 * i + 1)} ${sentence(3 * i + 2)}`,
+  );
+  for (const budget of [9, 20, 33, 50, 100, 1000]) {
+    const out = await packContext(texts, budget, words);
+    assert(words(out) <= budget, `${words(out)} > ${budget}`);
+  }
+  assertEquals(await packContext(texts, 1000, estimateTokens), await packContext(texts, 0, words));
+});
+
+Deno.test("the chunk that doesn't fit is cut on a sentence and packing stops", async () => {
+  const first = `${sentence(1)} ${sentence(2)}`;
+  const second = `${sentence(3)} ${sentence(4)} ${sentence(5)}`;
+  const out = await packContext([first, second, "short tail chunk"], 30, words);
+  assertEquals(out, `${first}\n\n${sentence(3)} ${sentence(4)}`);
+});
+
+Deno.test("paragraph boundaries beat sentence boundaries", async () => {
+  const text = `${sentence(1)} ${sentence(2)}\n\n${sentence(3)} ${sentence(4)} ${sentence(5)}`;
+  // a third sentence would fit, but the paragraph ends after two
+  assertEquals(await packContext([text], 24, words), `${sentence(1)} ${sentence(2)}`);
+});
+
+Deno.test("a piece too small to be worth it is dropped", async () => {
+  const texts = [`${sentence(1)} ${sentence(2)}`, `${sentence(3)} ${sentence(4)}`];
+  const out = await packContext(texts, 18, words);
+  assertEquals(out, `${sentence(1)} ${sentence(2)}`);
+});
@@ -0,0 +1,178 @@
+/**
+ * Worker pool for parallel scans.
+ *
+ * With `workers` set on Tieto, resident segments keep their rows in
+ * SharedArrayBuffers (see shareSegment()), so handing a segment to a worker
+ * costs nothing but a message. A large scan is cut into one shard of
+ * roughly equal row count per worker; each worker scores its shard into
+ * its own top-K with scanSegment() and posts that back, and the caller
+ * merges the lists. Segments ranked on a shortlist are only shortlisted
+ * by the workers: a shard's top rows aren't the segment's, so the caller
+ * merges the shard shortlists per segment and rescores those itself.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import type { Segment } from "./store.ts";
+import type { SegmentRows } from "./scan.ts";
+
+export interface ScanTask {
+  // candidate index the hits are tagged with
+  s: number;
+  seg: SegmentRows;
+  rows: Uint32Array;
+  // post back the rows' shortlist (see scan.ts shortlist()), not hits
+  shortlist: boolean;
+}
+
+export interface ScanHit {
+  score: number;
+  seg: number;
+  row: number;
+  extra: number;
+}
+
+export interface ScanRequest {
+  id: number;
+  q: Float32Array;
+  qNorm: number;
+  maxResults: number;
+  rescoreFactor: number;
+  simd: boolean;
+  // Matryoshka prefix width, 0 when off
+  prefixDims: number;
+  tasks: ScanTask[];
+}
+
+export interface ScanResult {
+  hits: ScanHit[];
+  // shortlist entries of the shortlist tasks, tagged with their `s`;
+  // score is the estimate the shortlist was picked on
+  shortlists: ScanHit[];
+}
+
+export interface ScanReply extends Partial<ScanResult> {
+  id: number;
+  error?: string;
+}
+
+type TypedArray = Float32Array | Int8Array | Uint32Array;
+
+// copy of `a` living in a SharedArrayBuffer
+function shared<T extends TypedArray>(a: T): T {
+  if (a.buffer instanceof SharedArrayBuffer) return a;
+  const ctor = a.constructor as new (buffer: SharedArrayBuffer) => T;
+  const out = new ctor(new SharedArrayBuffer(a.byteLength));
+  out.set(a as never);
+  return out;
+}
+
+// Move a segment's rows, norms, quantized codes and prefix copy into shared
+// memory, in place. Workers then read them without a copy.
+export function shareSegment(seg: Segment): void {
+  if (seg.vectors) seg.vectors = shared(seg.vectors);
+  seg.norms = shared(seg.norms);
+  if (seg.prefix) {
+    seg.prefix.vectors = shared(seg.prefix.vectors);
+    seg.prefix.norms = shared(seg.prefix.norms);
+  }
+  const quant = seg.quant;
+  if (quant) {
+    if (quant.scales) quant.scales = shared(quant.scales);
+    if (quant.codes) quant.codes = shared(quant.codes);
+    if (quant.bits) quant.bits = shared(quant.bits);
+  }
+}
+
+export class ScanPool {
+  readonly size: number;
+  private workers: Worker[] = [];
+  private pending = new Map<number, {
+    resolve: (result: ScanResult) => void;
+    reject: (e: Error) => void;
+  }>();
+  private nextId = 0;
+
+  constructor(size: number) {
+    this.size = Math.max(1, size);
+    for (let i = 0; i < this.size; i++) {
+      const worker = new Worker(new URL("./scan_worker.ts", import.meta.url).href, {
+        type: "module",
+      });
+      worker.onmessage = (e: MessageEvent<ScanReply>) => this.settle(e.data);
+      worker.onerror = (e: ErrorEvent) => {
+        e.preventDefault();
+        this.failAll(new Error(`Scan worker failed: ${e.message}`));
+      };
+      this.workers.push(worker);
+    }
+  }
+
+  private settle(reply: ScanReply): void {
+    const job = this.pending.get(reply.id);
+    if (!job) return;
+    this.pending.delete(reply.id);
+    if (reply.error !== undefined) job.reject(new Error(reply.error));
+    else job.resolve({ hits: reply.hits ?? [], shortlists: reply.shortlists ?? [] });
+  }
+
+  private failAll(e: Error): void {
+    for (const job of this.pending.values()) job.reject(e);
+    this.pending.clear();
+  }
+
+  // Split the tasks into one shard per worker by row count
+  private shard(tasks: ScanTask[]): ScanTask[][] {
+    const total = tasks.reduce((n, t) => n + t.rows.length, 0);
+    const per = Math.ceil(total / this.size);
+    const shards: ScanTask[][] = [];
+    let current: ScanTask[] = [];
+    let room = per;
+    for (const task of tasks) {
+      for (let at = 0; at < task.rows.length;) {
+        const take = Math.min(room, task.rows.length - at);
+        // slice, not subarray: only these rows get cloned into the message
+        current.push({ ...task, rows: task.rows.slice(at, at + take) });
+        at += take;
+        room -= take;
+        if (!room) {
+          shards.push(current);
+          current = [];
+          room = per;
+        }
+      }
+    }
+    if (current.length) shards.push(current);
+    return shards;
+  }
+
+  // Score every task's rows across the pool. Returns each worker's top
+  // hits (at most maxResults per worker) and shortlists, unmerged.
+  async scan(
+    tasks: ScanTask[],
+    q: Float32Array,
+    qNorm: number,
+    options: { maxResults: number; rescoreFactor: number; simd: boolean; prefixDims: number },
+  ): Promise<ScanResult> {
+    const shards = this.shard(tasks);
+    const replies = await Promise.all(shards.map((shard, w) =>
+      new Promise<ScanResult>((resolve, reject) => {
+        const id = this.nextId++;
+        this.pending.set(id, { resolve, reject });
+        const request: ScanRequest = { id, q, qNorm, ...options, tasks: shard };
+        this.workers[w].postMessage(request);
+      })
+    ));
+    return {
+      hits: replies.flatMap((r) => r.hits),
+      shortlists: replies.flatMap((r) => r.shortlists),
+    };
+  }
+
+  close(): void {
+    for (const worker of this.workers) worker.terminate();
+    this.workers = [];
+    this.failAll(new Error("Scan pool closed"));
+  }
+}
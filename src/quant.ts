@@ -0,0 +1,150 @@
+/**
+ * Scalar (int8) and binary (1-bit sign) quantization for Tieto.
+ *
+ * int8 keeps one Float32 scale per row and one signed byte per dimension
+ * (v ≈ scale * code), so a 768-dim row is 772 bytes instead of 3 KiB.
+ * binary keeps only the sign of each dimension, packed 32 to a word, and
+ * compares rows by Hamming distance (96 bytes for 768 dims).
+ *
+ * Either way the quantized rows are the shovel's first pass: they pick a
+ * shortlist cheaply, and search rescores that shortlist with the full
+ * Float32 rows when the segment still has them. Row norms of the original
+ * vectors are always kept, so distances can be estimated when it doesn't.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+export type QuantKind = "int8" | "binary";
+
+export interface QuantizedRows {
+  kind: QuantKind;
+  dim: number;
+  count: number;
+  // int8: one scale per row, codes are count * dim
+  scales?: Float32Array;
+  codes?: Int8Array;
+  // binary: count * wordsPerRow sign words
+  bits?: Uint32Array;
+}
+
+export function wordsPerRow(dim: number): number {
+  return (dim + 31) >>> 5;
+}
+
+// scale + codes for one vector
+function quantizeRowInt8(
+  src: Float32Array,
+  offset: number,
+  dim: number,
+  codes: Int8Array,
+  at: number,
+): number {
+  let max = 0;
+  for (let i = 0; i < dim; i++) max = Math.max(max, Math.abs(src[offset + i]));
+  const scale = max / 127 || 1;
+  for (let i = 0; i < dim; i++) codes[at + i] = Math.round(src[offset + i] / scale);
+  return scale;
+}
+
+function quantizeRowBinary(
+  src: Float32Array,
+  offset: number,
+  dim: number,
+  bits: Uint32Array,
+  at: number,
+): void {
+  for (let w = 0; w < wordsPerRow(dim); w++) bits[at + w] = 0;
+  for (let i = 0; i < dim; i++) {
+    if (src[offset + i] > 0) bits[at + (i >>> 5)] |= 1 << (i & 31);
+  }
+}
+
+export function quantize(
+  kind: QuantKind,
+  m: Float32Array,
+  dim: number,
+  count: number,
+): QuantizedRows {
+  if (kind === "int8") {
+    const scales = new Float32Array(count);
+    const codes = new Int8Array(count * dim);
+    for (let r = 0; r < count; r++) {
+      scales[r] = quantizeRowInt8(m, r * dim, dim, codes, r * dim);
+    }
+    return { kind, dim, count, scales, codes };
+  }
+  const words = wordsPerRow(dim);
+  const bits = new Uint32Array(count * words);
+  for (let r = 0; r < count; r++) quantizeRowBinary(m, r * dim, dim, bits, r * words);
+  return { kind, dim, count, bits };
+}
+
+function popcount(x: number): number {
+  x -= (x >>> 1) & 0x55555555;
+  x = (x & 0x33333333) + ((x >>> 2) & 0x33333333);
+  return (Math.imul((x + (x >>> 4)) & 0x0f0f0f0f, 0x01010101) >>> 24);
+}
+
+// Estimated cosine similarity of the query against `n` of the quantized
+// rows (rows[i], or i without `rows`) into out[]. int8 quantizes the query
+// the same way and takes an integer dot product; binary maps the Hamming
+// distance h to cos(pi * h / dim).
+export function approxCosines(
+  qr: QuantizedRows,
+  norms: Float32Array,
+  q: Float32Array,
+  qNorm: number,
+  n: number,
+  out: Float32Array,
+  rows?: Uint32Array,
+): void {
+  const dim = qr.dim;
+  if (qr.kind === "int8") {
+    const qCodes = new Int8Array(dim);
+    const qScale = quantizeRowInt8(q, 0, dim, qCodes, 0);
+    const codes = qr.codes!, scales = qr.scales!;
+    for (let i = 0; i < n; i++) {
+      const r = rows ? rows[i] : i;
+      const at = r * dim;
+      let acc = 0;
+      for (let d = 0; d < dim; d++) acc += codes[at + d] * qCodes[d];
+      const denom = norms[r] * qNorm;
+      out[i] = denom === 0 ? 0 : (acc * scales[r] * qScale) / denom;
+    }
+    return;
+  }
+
+  const words = wordsPerRow(dim);
+  const qBits = new Uint32Array(words);
+  quantizeRowBinary(q, 0, dim, qBits, 0);
+  const bits = qr.bits!;
+  for (let i = 0; i < n; i++) {
+    const at = (rows ? rows[i] : i) * words;
+    let h = 0;
+    for (let w = 0; w < words; w++) h += popcount(bits[at + w] ^ qBits[w]);
+    out[i] = Math.cos((Math.PI * h) / dim);
+  }
+}
+
+// Best available reconstruction of row r, written into out
+export function dequantizeRow(
+  qr: QuantizedRows,
+  norms: Float32Array,
+  r: number,
+  out: Float32Array,
+): Float32Array {
+  const dim = qr.dim;
+  if (qr.kind === "int8") {
+    const scale = qr.scales![r];
+    for (let d = 0; d < dim; d++) out[d] = qr.codes![r * dim + d] * scale;
+    return out;
+  }
+  // every coordinate gets the same magnitude, so the norm is preserved
+  const mag = norms[r] / Math.sqrt(dim);
+  const at = r * wordsPerRow(dim);
+  for (let d = 0; d < dim; d++) {
+    out[d] = qr.bits![at + (d >>> 5)] & (1 << (d & 31)) ? mag : -mag;
+  }
+  return out;
+}
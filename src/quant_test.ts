@@ -0,0 +1,62 @@
+/**
+ * Tests for int8 / binary quantization (quant.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assert, assertEquals } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { computeNorms, cosineFromDot, rowNorm, scoreRows } from "./kernels.ts";
+import { approxCosines, dequantizeRow, quantize } from "./quant.ts";
+import { randomRows } from "./test_util.ts";
+
+// not a multiple of 32, so binary rows end in a partial word
+const DIM = 45;
+const COUNT = 16;
+
+Deno.test("int8 rows dequantize to within half a step", () => {
+  const m = randomRows(COUNT, DIM, 1);
+  // and an all-zero row
+  m.fill(0, 0, DIM);
+  const norms = computeNorms(m, DIM, COUNT);
+  const qr = quantize("int8", m, DIM, COUNT);
+  assertEquals(qr.codes!.length, COUNT * DIM);
+  const out = new Float32Array(DIM);
+  for (let r = 0; r < COUNT; r++) {
+    dequantizeRow(qr, norms, r, out);
+    const step = qr.scales![r];
+    for (let d = 0; d < DIM; d++) {
+      assert(Math.abs(out[d] - m[r * DIM + d]) <= step / 2 + 1e-6, `row ${r} dim ${d}`);
+    }
+  }
+});
+
+Deno.test("binary rows dequantize to their signs, at the row's norm", () => {
+  const m = randomRows(COUNT, DIM, 2);
+  const norms = computeNorms(m, DIM, COUNT);
+  const qr = quantize("binary", m, DIM, COUNT);
+  assertEquals(qr.bits!.length, COUNT * 2);
+  const out = new Float32Array(DIM);
+  for (let r = 0; r < COUNT; r++) {
+    dequantizeRow(qr, norms, r, out);
+    for (let d = 0; d < DIM; d++) {
+      assertEquals(out[d] > 0, m[r * DIM + d] > 0, `row ${r} dim ${d}`);
+    }
+    assert(Math.abs(rowNorm(out, 0, DIM) - norms[r]) < 1e-4);
+  }
+});
+
+Deno.test("int8 cosine estimates stay close to the exact ones", () => {
+  const m = randomRows(COUNT, DIM, 3);
+  const norms = computeNorms(m, DIM, COUNT);
+  const q = randomRows(1, DIM, 4);
+  const qNorm = rowNorm(q, 0, DIM);
+  const dots = new Float32Array(COUNT), sqDists = new Float32Array(COUNT);
+  scoreRows(m, DIM, COUNT, q, dots, sqDists);
+  const approx = new Float32Array(COUNT);
+  approxCosines(quantize("int8", m, DIM, COUNT), norms, q, qNorm, COUNT, approx);
+  for (let r = 0; r < COUNT; r++) {
+    const exact = cosineFromDot(dots[r], norms[r], qNorm);
+    assert(Math.abs(approx[r] - exact) < 0.02, `row ${r}: ${approx[r]} vs ${exact}`);
+  }
+});
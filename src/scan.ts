@@ -0,0 +1,197 @@
+/**
+ * Scoring one segment's rows into a TopK, shared by the main thread and
+ * the scan workers (see pool.ts), so a parallel scan ranks exactly like a
+ * serial one. A segment ranked on a shortlist (quantized, or with a
+ * Matryoshka prefix) is only shortlisted on the workers: their shortlists
+ * are merged into the one a serial scan would have picked, and that is
+ * rescored in one go. scanSegmentBatch() does the same for many questions
+ * at once.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import {
+  BlockScorer,
+  cosineFromDot,
+  dotBlock,
+  RowScorer,
+  rowNorm,
+  TopK,
+} from "./kernels.ts";
+import { approxCosines } from "./quant.ts";
+import type { PrefixRows } from "./matryoshka.ts";
+import type { Segment } from "./store.ts";
+
+// the parts of a segment scoring reads (workers never see texts / docs)
+export type SegmentRows = Pick<Segment, "dim" | "count" | "vectors" | "norms" | "quant" | "prefix">;
+
+export interface ScanOptions {
+  scorer: RowScorer;
+  maxResults: number;
+  rescoreFactor: number;
+  // scorer for seg.prefix rows; without one the prefix isn't used
+  prefixScorer?: RowScorer;
+  // many-question kernel for scanSegmentBatch(); default: dotBlock()
+  blockScorer?: BlockScorer;
+}
+
+// Score `rows` of one segment and offer them to `top` (tagged with the
+// candidate index `s`). dots / sqDists are scratch, at least rows long.
+//
+// Cosine similarity is the steam shovel, Euclidean distance the sifter;
+// both come out of the same pass over each row. A quantized segment gets
+// an extra, cheaper shovel first: quantized scores pick a shortlist of
+// rescoreFactor * maxResults rows, and only those are rescored in full
+// precision. Without full-precision rows the estimates are final, and the
+// distance is rebuilt from the norms: |a-q|² = |a|² + |q|² - 2|a||q|cos.
+// Full-precision segments with a Matryoshka prefix (see matryoshka.ts)
+// get the same treatment, with the shortlist picked on the prefix.
+export function scanSegment(
+  seg: SegmentRows,
+  rows: Uint32Array,
+  qVec: Float32Array,
+  qNorm: number,
+  s: number,
+  top: TopK,
+  options: ScanOptions,
+  dots: Float32Array,
+  sqDists: Float32Array,
+): void {
+  const keep = options.maxResults * options.rescoreFactor;
+  if (shortlisted(seg, rows.length, options)) {
+    const picked = shortlist(seg, rows, qVec, qNorm, s, keep, options, dots, sqDists).sorted();
+    if (!seg.vectors) {
+      for (const { score, row } of picked) {
+        const na = seg.norms[row];
+        const sq = Math.max(0, na * na + qNorm * qNorm - 2 * na * qNorm * score);
+        if (score > top.floor) top.push(score, s, row, sq);
+      }
+      return;
+    }
+    rows = Uint32Array.from(picked, (p) => p.row).sort();
+  }
+
+  options.scorer(seg.vectors!, seg.dim, rows.length, qVec, dots, sqDists, rows);
+  for (let i = 0; i < rows.length; i++) {
+    const score = cosineFromDot(dots[i], seg.norms[rows[i]], qNorm);
+    if (score > top.floor) top.push(score, s, rows[i], sqDists[i]);
+  }
+}
+
+// scanSegment() ranks `count` rows of `seg` on a shortlist: always for a
+// quantized segment, for a prefixed one when there are more rows than it
+// would keep
+export function shortlisted(
+  seg: SegmentRows,
+  count: number,
+  options: Pick<ScanOptions, "maxResults" | "rescoreFactor" | "prefixScorer">,
+): boolean {
+  if (seg.quant) return true;
+  return !!(seg.prefix && options.prefixScorer) &&
+    count > options.maxResults * options.rescoreFactor;
+}
+
+// The `keep` (or fewer) of `rows` scoring best on the cheap estimate,
+// tagged with `s`: quantized scores, or the prefix cosine. Shortlists of
+// disjoint row ranges merge into the one of their union.
+export function shortlist(
+  seg: SegmentRows,
+  rows: Uint32Array,
+  qVec: Float32Array,
+  qNorm: number,
+  s: number,
+  keep: number,
+  options: ScanOptions,
+  dots: Float32Array,
+  sqDists: Float32Array,
+): TopK {
+  const list = new TopK(Math.min(rows.length, keep));
+  if (seg.quant) {
+    approxCosines(seg.quant, seg.norms, qVec, qNorm, rows.length, dots, rows);
+  } else {
+    prefixCosines(seg.prefix!, rows, qVec, options.prefixScorer!, dots, sqDists);
+  }
+  for (let i = 0; i < rows.length; i++) {
+    if (dots[i] > list.floor) list.push(dots[i], s, rows[i]);
+  }
+  return list;
+}
+
+// Cosines of `rows` on their leading dimensions alone, into dots
+function prefixCosines(
+  prefix: PrefixRows,
+  rows: Uint32Array,
+  qVec: Float32Array,
+  scorer: RowScorer,
+  dots: Float32Array,
+  sqDists: Float32Array,
+): void {
+  const q = qVec.subarray(0, prefix.dim);
+  const qNorm = rowNorm(q, 0, prefix.dim);
+  scorer(prefix.vectors, prefix.dim, rows.length, q, dots, sqDists, rows);
+  for (let i = 0; i < rows.length; i++) {
+    dots[i] = cosineFromDot(dots[i], prefix.norms[rows[i]], qNorm);
+  }
+}
+
+// scanSegmentBatch() tiling: a block of rows stays in L2 while every block
+// of queries (small enough for L1) passes over it, so the segment itself
+// is read from memory once per batch rather than once per question
+const ROW_BLOCK = 256;
+const QUERY_BLOCK = 16;
+
+// scratch for scanSegmentBatch()
+export function batchScratch(): Float64Array {
+  return new Float64Array(ROW_BLOCK * QUERY_BLOCK);
+}
+
+// scanSegment() for `tops.length` questions packed row-major in `qs`, as
+// one blocked query-matrix x segment-matrix product. Distances come from
+// the norms (|a-q|² = |a|² + |q|² - 2a·q) rather than a second pass.
+// Quantized segments take the per-question path, shortlist and all.
+export function scanSegmentBatch(
+  seg: SegmentRows,
+  rows: Uint32Array,
+  qs: Float32Array,
+  qNorms: Float32Array,
+  s: number,
+  tops: TopK[],
+  options: ScanOptions,
+  scratch: Float64Array,
+  dots: Float32Array,
+  sqDists: Float32Array,
+): void {
+  const { dim } = seg;
+  const nq = tops.length;
+  if (seg.quant) {
+    for (let j = 0; j < nq; j++) {
+      const q = qs.subarray(j * dim, (j + 1) * dim);
+      scanSegment(seg, rows, q, qNorms[j], s, tops[j], options, dots, sqDists);
+    }
+    return;
+  }
+
+  const m = seg.vectors!;
+  const block = options.blockScorer ?? dotBlock;
+  for (let r0 = 0; r0 < rows.length; r0 += ROW_BLOCK) {
+    const r1 = Math.min(rows.length, r0 + ROW_BLOCK);
+    for (let q0 = 0; q0 < nq; q0 += QUERY_BLOCK) {
+      const q1 = Math.min(nq, q0 + QUERY_BLOCK);
+      block(m, dim, rows, r0, r1, qs, q0, q1, scratch, QUERY_BLOCK);
+      for (let i = r0; i < r1; i++) {
+        const row = rows[i];
+        const na = seg.norms[row];
+        const o = (i - r0) * QUERY_BLOCK - q0;
+        for (let j = q0; j < q1; j++) {
+          const dot = scratch[o + j];
+          const score = cosineFromDot(dot, na, qNorms[j]);
+          if (score > tops[j].floor) {
+            const sq = Math.max(0, na * na + qNorms[j] * qNorms[j] - 2 * dot);
+            tops[j].push(score, s, row, sq);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,53 @@
+/// <reference lib="deno.worker" />
+
+/**
+ * Scan worker: scores the shard of rows it's handed (see pool.ts) and
+ * posts back its own top-K, plus the shortlists it was asked for.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { RowScorer, scoreRows, TopK } from "./kernels.ts";
+import { createSimdScorer } from "./simd.ts";
+import { scanSegment, shortlist } from "./scan.ts";
+import type { ScanHit, ScanReply, ScanRequest } from "./pool.ts";
+
+let simdScorer: RowScorer | null | undefined;
+
+function scorerFor(dim: number, simd: boolean): RowScorer {
+  if (!simd || dim % 4 !== 0) return scoreRows;
+  if (simdScorer === undefined) simdScorer = createSimdScorer();
+  return simdScorer ?? scoreRows;
+}
+
+self.onmessage = (e: MessageEvent<ScanRequest>) => {
+  const { id, q, qNorm, maxResults, rescoreFactor, simd, prefixDims, tasks } = e.data;
+  let reply: ScanReply;
+  try {
+    const top = new TopK(maxResults);
+    const shortlists: ScanHit[] = [];
+    const most = tasks.reduce((m, t) => Math.max(m, t.rows.length), 0);
+    const dots = new Float32Array(most);
+    const sqDists = new Float32Array(most);
+    for (const { s, seg, rows, shortlist: listed } of tasks) {
+      const options = {
+        scorer: scorerFor(seg.dim, simd),
+        maxResults,
+        rescoreFactor,
+        prefixScorer: prefixDims ? scorerFor(prefixDims, simd) : undefined,
+      };
+      if (listed) {
+        const keep = maxResults * rescoreFactor;
+        const list = shortlist(seg, rows, q, qNorm, s, keep, options, dots, sqDists);
+        shortlists.push(...list.sorted());
+      } else {
+        scanSegment(seg, rows, q, qNorm, s, top, options, dots, sqDists);
+      }
+    }
+    reply = { id, hits: top.sorted(), shortlists };
+  } catch (err) {
+    reply = { id, error: err instanceof Error ? err.message : String(err) };
+  }
+  self.postMessage(reply);
+};
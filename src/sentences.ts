@@ -0,0 +1,63 @@
+/**
+ * Sentence boundaries for Tieto's chunker and context packer.
+ *
+ * A sentence ends at ".", "!" or "?" (plus any closing quotes / brackets)
+ * followed by whitespace or the end of the text. A period after a common
+ * abbreviation ("Dr.", "e.g.") or a single capital initial ("J. Smith")
+ * doesn't end one. That's a heuristic, not a parser: a sentence that really
+ * does end on "etc." or an initial runs on into the next one.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+const TERMINAL = new Set([".", "!", "?"]);
+const CLOSING = new Set(['"', "'", ")", "]"]);
+
+// lowercased, without the final period
+const ABBREVIATIONS = new Set([
+  "mr", "mrs", "ms", "dr", "prof", "sr", "jr", "st", "mt", "vs", "cf", "fig",
+  "no", "vol", "approx", "e.g", "i.e", "a.m", "p.m", "u.s",
+]);
+
+export const isSpace = (c: number) => c === 32 || c === 9 || c === 13 || c === 10;
+
+// the period at text[i] ends an abbreviation or an initial
+function abbreviation(text: string, i: number): boolean {
+  let start = i;
+  while (start > 0 && /[A-Za-z.]/.test(text[start - 1])) start--;
+  const word = text.slice(start, i);
+  if (word.length === 1 && word >= "A" && word <= "Z") return true;
+  return ABBREVIATIONS.has(word.toLowerCase());
+}
+
+// End of the sentence starting at `start`: after its closing punctuation
+// (and quotes / brackets), or `end`
+export function sentenceEnd(text: string, start: number, end: number): number {
+  for (let i = start; i < end; i++) {
+    if (!TERMINAL.has(text[i])) continue;
+    let j = i + 1;
+    while (j < end && (TERMINAL.has(text[j]) || CLOSING.has(text[j]))) j++;
+    const boundary = j === end || isSpace(text.charCodeAt(j));
+    // "Dr. Smith", "J. Smith": a bare period after an abbreviation
+    if (boundary && !(j === i + 1 && text[i] === "." && abbreviation(text, i))) return j;
+    i = j - 1;
+  }
+  return end;
+}
+
+// [start, end) of each sentence of `text`, surrounding whitespace excluded
+export function sentenceSpans(text: string): [number, number][] {
+  const spans: [number, number][] = [];
+  let start = 0;
+  while (start < text.length && isSpace(text.charCodeAt(start))) start++;
+  while (start < text.length) {
+    const stop = sentenceEnd(text, start, text.length);
+    let e = stop;
+    while (e > start && isSpace(text.charCodeAt(e - 1))) e--;
+    spans.push([start, e]);
+    start = stop;
+    while (start < text.length && isSpace(text.charCodeAt(start))) start++;
+  }
+  return spans;
+}
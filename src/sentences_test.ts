@@ -0,0 +1,41 @@
+/**
+ * Tests for sentence boundaries (sentences.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assertEquals } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { sentenceSpans } from "./sentences.ts";
+
+const sentences = (text: string) => sentenceSpans(text).map(([s, e]) => text.slice(s, e));
+
+Deno.test("sentences end at terminal punctuation and closing quotes", () => {
+  assertEquals(sentences('  One. Two?! "Three." (Four.) Five'), [
+    "One.",
+    "Two?!",
+    '"Three."',
+    "(Four.)",
+    "Five",
+  ]);
+  // no space after the period: a number or a file name, not an end
+  assertEquals(sentences("Version 1.2 is out. See notes.md for more."), [
+    "Version 1.2 is out.",
+    "See notes.md for more.",
+  ]);
+});
+
+Deno.test("abbreviations and initials don't end a sentence", () => {
+  assertEquals(sentences("Dr. Smith met J. R. Jones at 9 a.m. today. Use e.g. tabs. Mr. X left."), [
+    "Dr. Smith met J. R. Jones at 9 a.m. today.",
+    "Use e.g. tabs.",
+    "Mr. X left.",
+  ]);
+  // an abbreviation followed by more punctuation still ends one
+  assertEquals(sentences("Ask the Dr.? Yes."), ["Ask the Dr.?", "Yes."]);
+});
+
+Deno.test("whitespace-only text has no sentences", () => {
+  assertEquals(sentenceSpans(" \n\t "), []);
+  assertEquals(sentenceSpans(""), []);
+});
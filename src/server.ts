@@ -0,0 +1,219 @@
+/**
+ * HTTP server mode for Tieto (`tieto serve`).
+ *
+ * One long-lived Tieto instance answers every request, so resident
+ * segments, IVF indexes, the embedding cache, the worker pool and the HTTP
+ * client's connections are shared between them. Once a topic is warm, a
+ * query costs scoring (and the model round trips), not process startup
+ * and disk reads. Deno.serve handles requests concurrently.
+ *
+ * All endpoints take and return JSON:
+ *
+ *   POST /search  {topic | topics, question, filters?}
+ *                 → {chunks, metrics}
+ *   POST /query   {topic | topics, question, filters?, stream?}
+ *                 → {chunks, prompt, response, metrics}; with stream, the
+ *                   completion as server-sent events (data: JSON string per
+ *                   token, then [DONE])
+ *   POST /ingest  {topic, file?}         ingest one file of the topic, or
+ *                                        the whole topic without `file`
+ *                 {topic, text, meta?}   remember() one text
+ *   GET  /health
+ *
+ * `filters` is a list of filter objects, or of --filter style strings
+ * ("status=current|status=draft", "!tag=internal").
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import type { FilterExpr, QueryMetrics, Tieto } from "./tieto.class.ts";
+import { isFilterExpr } from "./filters.ts";
+
+export interface ServeOptions {
+  hostname?: string;
+  port?: number;
+  // topics to load before the first request
+  warm?: string[];
+  signal?: AbortSignal;
+}
+
+// an error the client caused; anything else is a 500
+class BadRequest extends Error {
+  status: number;
+  constructor(message: string, status = 400) {
+    super(message);
+    this.status = status;
+  }
+}
+
+// topic names become directory names; keep requests inside the topics
+// directory
+const TOPIC_NAME = /^[\w][\w.-]*$/;
+
+function json(body: unknown, status = 200): Response {
+  return Response.json(body, { status });
+}
+
+function topicsOf(body: Record<string, unknown>): string[] {
+  const topics = body.topics ?? (body.topic === undefined ? undefined : [body.topic]);
+  if (!Array.isArray(topics) || !topics.length) {
+    throw new BadRequest("'topic' or 'topics' is required");
+  }
+  for (const t of topics) {
+    if (typeof t !== "string" || !TOPIC_NAME.test(t)) {
+      throw new BadRequest(`Bad topic name: ${JSON.stringify(t)}`);
+    }
+  }
+  return topics;
+}
+
+function questionOf(body: Record<string, unknown>): string {
+  if (typeof body.question !== "string" || !body.question.trim()) {
+    throw new BadRequest("'question' is required");
+  }
+  return body.question;
+}
+
+function filtersOf(tieto: Tieto, body: Record<string, unknown>): FilterExpr[] {
+  const raw = body.filters ?? [];
+  if (!Array.isArray(raw)) throw new BadRequest("'filters' must be a list");
+  const filters: FilterExpr[] = [];
+  for (const f of raw) {
+    if (typeof f === "string") {
+      const parsed = tieto.parseFilters(["--filter", f]);
+      if (!parsed.length) throw new BadRequest(`Bad filter expression: '${f}'`);
+      filters.push(...parsed);
+    } else if (isFilterExpr(f)) {
+      filters.push(f);
+    } else {
+      throw new BadRequest(`Bad filter: ${JSON.stringify(f)}`);
+    }
+  }
+  return filters;
+}
+
+// results without their embeddings, which nobody on the wire needs
+function publicChunks(chunks: { embedding?: unknown }[]) {
+  return chunks.map(({ embedding: _, ...rest }) => rest);
+}
+
+// tokens as server-sent events
+function eventStream(tokens: AsyncGenerator<string>): Response {
+  const encoder = new TextEncoder();
+  const body = new ReadableStream<Uint8Array>({
+    async pull(controller) {
+      try {
+        const { value, done } = await tokens.next();
+        if (done) {
+          controller.enqueue(encoder.encode("data: [DONE]\n\n"));
+          controller.close();
+          return;
+        }
+        controller.enqueue(encoder.encode(`data: ${JSON.stringify(value)}\n\n`));
+      } catch (e) {
+        const message = e instanceof Error ? e.message : String(e);
+        controller.enqueue(encoder.encode(`event: error\ndata: ${JSON.stringify(message)}\n\n`));
+        controller.close();
+      }
+    },
+    // client went away: stop generating
+    async cancel() {
+      await tokens.return(undefined);
+    },
+  });
+  return new Response(body, {
+    headers: {
+      "Content-Type": "text/event-stream",
+      "Cache-Control": "no-cache",
+    },
+  });
+}
+
+// The request handler on its own, e.g. to mount it in another server
+export function createHandler(tieto: Tieto): (req: Request) => Promise<Response> {
+  const routes: Record<string, (body: Record<string, unknown>) => Promise<Response>> = {
+    "/search": async (body) => {
+      const topics = topicsOf(body);
+      const question = questionOf(body);
+      const filters = filtersOf(tieto, body);
+      let metrics: QueryMetrics | undefined;
+      const chunks = await tieto.searchMany(topics, question, filters, (m) => metrics = m);
+      return json({ chunks: publicChunks(chunks), metrics });
+    },
+
+    "/query": async (body) => {
+      const topics = topicsOf(body);
+      const question = questionOf(body);
+      const filters = filtersOf(tieto, body);
+      if (body.stream) return eventStream(tieto.queryStream(topics, question, filters));
+      const result = await tieto.query(topics, question, filters, true);
+      if (typeof result === "string") return json({ response: result });
+      return json({ ...result, chunks: publicChunks(result.chunks) });
+    },
+
+    "/ingest": async (body) => {
+      const [topic] = topicsOf(body);
+      if (typeof body.text === "string") {
+        const meta = body.meta && typeof body.meta === "object"
+          ? body.meta as Record<string, unknown>
+          : {};
+        await tieto.remember(topic, body.text, meta);
+        return json({ remembered: 1 });
+      }
+      if (body.file !== undefined) {
+        if (typeof body.file !== "string" || !TOPIC_NAME.test(body.file)) {
+          throw new BadRequest(`Bad file name: ${JSON.stringify(body.file)}`);
+        }
+        const { topicsDirectory } = tieto.getConfig();
+        await tieto.ingest(join(topicsDirectory, topic, body.file));
+        return json({ ingested: 1 });
+      }
+      return json({ ingested: await tieto.ingestTopic(topic) });
+    },
+  };
+
+  return async (req) => {
+    const { pathname } = new URL(req.url);
+    if (pathname === "/health") return json({ ok: true });
+    const route = routes[pathname];
+    if (!route) return json({ error: "Not found" }, 404);
+    if (req.method !== "POST") return json({ error: "Use POST" }, 405);
+
+    try {
+      let body: unknown;
+      try {
+        body = await req.json();
+      } catch {
+        throw new BadRequest("Request body must be JSON");
+      }
+      if (!body || typeof body !== "object" || Array.isArray(body)) {
+        throw new BadRequest("Request body must be a JSON object");
+      }
+      return await route(body as Record<string, unknown>);
+    } catch (e) {
+      if (e instanceof BadRequest) return json({ error: e.message }, e.status);
+      if (e instanceof Deno.errors.NotFound) {
+        return json({ error: "Topic or file not found" }, 404);
+      }
+      console.error(`${req.method} ${pathname} failed:`, e);
+      return json({ error: e instanceof Error ? e.message : String(e) }, 500);
+    }
+  };
+}
+
+// Serve `tieto` until `signal` aborts (or SIGINT / SIGTERM, from the CLI)
+export async function serve(tieto: Tieto, options: ServeOptions = {}): Promise<void> {
+  for (const topic of options.warm ?? []) await tieto.warm(topic);
+  const server = Deno.serve({
+    hostname: options.hostname ?? "127.0.0.1",
+    port: options.port ?? 8000,
+    signal: options.signal,
+    onListen({ hostname, port }) {
+      console.log(`Tieto listening on http://${hostname}:${port}`);
+    },
+  }, createHandler(tieto));
+  await server.finished;
+  tieto.close();
+}
@@ -0,0 +1,214 @@
+/**
+ * Optional WebAssembly SIMD scoring kernel for Tieto.
+ *
+ * A tiny hand-assembled module with one export, score(q, m, rows, dim, out),
+ * that walks `rows` contiguous rows of `dim` floats and writes the dot
+ * product and squared Euclidean distance against the query for each row,
+ * four lanes at a time (128-bit f32x4). It is the same fused pass as
+ * dotAndSqDist() in kernels.ts, just wider.
+ *
+ * Rows are copied into the module's memory a block at a time (sized to sit
+ * in L2), so segments keep living in ordinary typed arrays and filtered row
+ * sets can be gathered on the way in. createSimdBlockScorer() copies one
+ * block in and scores it against a whole block of questions before moving
+ * on, so a batch reads the segment once instead of once per question. If
+ * the runtime can't compile the module (no WASM, or no SIMD), both return
+ * null and callers stay on scoreRows() / dotBlock() from kernels.ts.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import type { BlockScorer, RowScorer } from "./kernels.ts";
+
+// bytes of rows copied into wasm memory per call
+const BLOCK_BYTES = 256 * 1024;
+const PAGE_BYTES = 64 * 1024;
+
+// opcodes used below
+const I32 = 0x7f, V128 = 0x7b;
+const BLOCK = 0x02, LOOP = 0x03, END = 0x0b, BR = 0x0c, BR_IF = 0x0d, VOID = 0x40;
+const GET = 0x20, SET = 0x21, TEE = 0x22;
+const I32_CONST = 0x41, I32_EQZ = 0x45, I32_GE_U = 0x4f;
+const I32_ADD = 0x6a, I32_SUB = 0x6b, I32_MUL = 0x6c;
+const F32_ADD = 0x92, F32_STORE = 0x38;
+const SIMD = 0xfd;
+const V128_LOAD = [SIMD, 0x00, 0x02, 0x00];
+const V128_ZERO = [SIMD, 0x0c, ...new Array(16).fill(0)];
+const F32X4_ADD = [SIMD, 0xe4, 0x01];
+const F32X4_SUB = [SIMD, 0xe5, 0x01];
+const F32X4_MUL = [SIMD, 0xe6, 0x01];
+const lane = (i: number) => [SIMD, 0x1f, i];
+
+// params
+const Q = 0, M = 1, ROWS = 2, DIM = 3, OUT = 4;
+// locals
+const QP = 5, END_PTR = 6, ACC_DOT = 7, ACC_SQ = 8, A = 9, B = 10;
+
+// sum the four lanes of a v128 local onto the stack
+const hsum = (local: number) => [
+  GET, local, ...lane(0),
+  GET, local, ...lane(1), F32_ADD,
+  GET, local, ...lane(2), F32_ADD,
+  GET, local, ...lane(3), F32_ADD,
+];
+
+const BODY = [
+  // locals: 2 x i32, 4 x v128
+  0x02, 0x02, I32, 0x04, V128,
+  BLOCK, VOID,
+  LOOP, VOID,
+  GET, ROWS, I32_EQZ, BR_IF, 1,
+  ...V128_ZERO, SET, ACC_DOT,
+  ...V128_ZERO, SET, ACC_SQ,
+  GET, Q, SET, QP,
+  GET, M, GET, DIM, I32_CONST, 4, I32_MUL, I32_ADD, SET, END_PTR,
+  BLOCK, VOID,
+  LOOP, VOID,
+  GET, M, GET, END_PTR, I32_GE_U, BR_IF, 1,
+  GET, M, ...V128_LOAD, SET, A,
+  GET, QP, ...V128_LOAD, SET, B,
+  // acc_dot += a * b
+  GET, ACC_DOT, GET, A, GET, B, ...F32X4_MUL, ...F32X4_ADD, SET, ACC_DOT,
+  // acc_sq += (a - b)^2
+  GET, A, GET, B, ...F32X4_SUB, TEE, A, GET, A, ...F32X4_MUL,
+  GET, ACC_SQ, ...F32X4_ADD, SET, ACC_SQ,
+  GET, M, I32_CONST, 16, I32_ADD, SET, M,
+  GET, QP, I32_CONST, 16, I32_ADD, SET, QP,
+  BR, 0,
+  END,
+  END,
+  // out[0] = dot, out[1] = squared distance
+  GET, OUT, ...hsum(ACC_DOT), F32_STORE, 0x02, 0x00,
+  GET, OUT, ...hsum(ACC_SQ), F32_STORE, 0x02, 0x04,
+  GET, OUT, I32_CONST, 8, I32_ADD, SET, OUT,
+  GET, ROWS, I32_CONST, 1, I32_SUB, SET, ROWS,
+  BR, 0,
+  END,
+  END,
+  END,
+];
+
+// unsigned LEB128
+function leb(n: number): number[] {
+  const out: number[] = [];
+  do {
+    let byte = n & 0x7f;
+    n >>>= 7;
+    if (n) byte |= 0x80;
+    out.push(byte);
+  } while (n);
+  return out;
+}
+
+const section = (id: number, payload: number[]) => [id, ...leb(payload.length), ...payload];
+const name = (s: string) => [s.length, ...Array.from(s, (c) => c.charCodeAt(0))];
+
+const MODULE = new Uint8Array([
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+  // type: (i32 i32 i32 i32 i32) -> ()
+  ...section(1, [0x01, 0x60, 0x05, I32, I32, I32, I32, I32, 0x00]),
+  // function 0 has type 0
+  ...section(3, [0x01, 0x00]),
+  // one memory, min 1 page
+  ...section(5, [0x01, 0x00, 0x01]),
+  ...section(7, [0x02, ...name("memory"), 0x02, 0x00, ...name("score"), 0x00, 0x00]),
+  ...section(10, [0x01, ...leb(BODY.length), ...BODY]),
+]);
+
+interface Kernel {
+  memory: WebAssembly.Memory;
+  score: (q: number, m: number, rows: number, dim: number, out: number) => void;
+  // grow memory to at least `bytes`
+  reserve: (bytes: number) => void;
+}
+
+// a fresh instance of the module, or null if it can't be compiled
+function instantiate(): Kernel | null {
+  let instance: WebAssembly.Instance;
+  try {
+    instance = new WebAssembly.Instance(new WebAssembly.Module(MODULE));
+  } catch {
+    return null;
+  }
+  const memory = instance.exports.memory as WebAssembly.Memory;
+  return {
+    memory,
+    score: instance.exports.score as Kernel["score"],
+    reserve: (bytes) => {
+      if (memory.buffer.byteLength < bytes) {
+        memory.grow(Math.ceil((bytes - memory.buffer.byteLength) / PAGE_BYTES));
+      }
+    },
+  };
+}
+
+// A RowScorer backed by the module above, or null if it can't be compiled
+export function createSimdScorer(): RowScorer | null {
+  const kernel = instantiate();
+  if (!kernel) return null;
+  const { memory, score, reserve } = kernel;
+
+  return (m, dim, count, q, dots, sqDists, rows) => {
+    if (dim % 4 !== 0) {
+      throw new Error("SIMD scorer needs a dimension divisible by 4");
+    }
+    const rowBytes = dim * 4;
+    const blockRows = Math.max(1, Math.floor(BLOCK_BYTES / rowBytes));
+    // [query][block of rows][out pairs]
+    const blockAt = rowBytes;
+    const outAt = blockAt + blockRows * rowBytes;
+    reserve(outAt + blockRows * 8);
+    // views are taken after any grow(), which detaches the old buffer
+    const heap = new Float32Array(memory.buffer);
+    heap.set(q, 0);
+
+    for (let start = 0; start < count; start += blockRows) {
+      const n = Math.min(blockRows, count - start);
+      if (rows) {
+        for (let i = 0; i < n; i++) {
+          const r = rows[start + i];
+          heap.set(m.subarray(r * dim, r * dim + dim), (blockAt >> 2) + i * dim);
+        }
+      } else {
+        heap.set(m.subarray(start * dim, (start + n) * dim), blockAt >> 2);
+      }
+      score(0, blockAt, n, dim, outAt);
+      for (let i = 0, o = outAt >> 2; i < n; i++, o += 2) {
+        dots[start + i] = heap[o];
+        sqDists[start + i] = heap[o + 1];
+      }
+    }
+  };
+}
+
+// A BlockScorer backed by the module, or null if it can't be compiled. The
+// rows are copied in once per call and stay in cache while each question
+// of the block is scored against them.
+export function createSimdBlockScorer(): BlockScorer | null {
+  const kernel = instantiate();
+  if (!kernel) return null;
+  const { memory, score, reserve } = kernel;
+
+  return (m, dim, rows, r0, r1, qs, q0, q1, out, stride) => {
+    if (dim % 4 !== 0) {
+      throw new Error("SIMD scorer needs a dimension divisible by 4");
+    }
+    const n = r1 - r0, nq = q1 - q0;
+    const rowBytes = dim * 4;
+    // [questions][rows][out pairs]
+    const blockAt = nq * rowBytes;
+    const outAt = blockAt + n * rowBytes;
+    reserve(outAt + n * 8);
+    const heap = new Float32Array(memory.buffer);
+    heap.set(qs.subarray(q0 * dim, q1 * dim), 0);
+    for (let i = 0; i < n; i++) {
+      const r = rows[r0 + i];
+      heap.set(m.subarray(r * dim, r * dim + dim), (blockAt >> 2) + i * dim);
+    }
+    for (let j = 0; j < nq; j++) {
+      score(j * rowBytes, blockAt, n, dim, outAt);
+      for (let i = 0, o = outAt >> 2; i < n; i++, o += 2) out[i * stride + j] = heap[o];
+    }
+  };
+}
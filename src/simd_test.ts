@@ -0,0 +1,90 @@
+/**
+ * The WASM SIMD kernel (simd.ts) against the plain JS one it stands in
+ * for. Skipped where the runtime can't compile the module.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assert, assertThrows } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { dotBlock, scoreRows } from "./kernels.ts";
+import { createSimdBlockScorer, createSimdScorer } from "./simd.ts";
+import { randomRows } from "./test_util.ts";
+
+const DIMS = [4, 8, 12, 100, 384, 768, 1024];
+// not a multiple of any block size
+const COUNT = 301;
+
+const simdScorer = createSimdScorer();
+const simdBlockScorer = createSimdBlockScorer();
+
+// Float32 sums taken in another order: close, not identical
+function assertClose(actual: ArrayLike<number>, expected: ArrayLike<number>, what: string) {
+  for (let i = 0; i < expected.length; i++) {
+    const tolerance = 1e-4 * Math.max(1, Math.abs(expected[i]));
+    assert(
+      Math.abs(actual[i] - expected[i]) <= tolerance,
+      `${what}[${i}]: ${actual[i]} vs ${expected[i]}`,
+    );
+  }
+}
+
+for (const dim of DIMS) {
+  Deno.test({
+    name: `SIMD scorer matches scoreRows at ${dim} dims`,
+    ignore: !simdScorer,
+    fn() {
+      const m = randomRows(COUNT, dim, dim);
+      const q = randomRows(1, dim, dim + 1);
+      const dots = new Float32Array(COUNT), sqDists = new Float32Array(COUNT);
+      const wantDots = new Float32Array(COUNT), wantSqDists = new Float32Array(COUNT);
+      scoreRows(m, dim, COUNT, q, wantDots, wantSqDists);
+      simdScorer!(m, dim, COUNT, q, dots, sqDists);
+      assertClose(dots, wantDots, "dots");
+      assertClose(sqDists, wantSqDists, "sqDists");
+
+      // a filtered subset, out of order
+      const rows = Uint32Array.from({ length: 77 }, (_, i) => (i * 97) % COUNT);
+      scoreRows(m, dim, rows.length, q, wantDots, wantSqDists, rows);
+      simdScorer!(m, dim, rows.length, q, dots, sqDists, rows);
+      assertClose(dots.subarray(0, rows.length), wantDots.subarray(0, rows.length), "dots");
+      assertClose(
+        sqDists.subarray(0, rows.length),
+        wantSqDists.subarray(0, rows.length),
+        "sqDists",
+      );
+    },
+  });
+}
+
+for (const dim of DIMS) {
+  Deno.test({
+    name: `SIMD block scorer matches dotBlock at ${dim} dims`,
+    ignore: !simdBlockScorer,
+    fn() {
+      const m = randomRows(COUNT, dim, dim);
+      const qs = randomRows(7, dim, dim + 2);
+      const rows = Uint32Array.from({ length: 120 }, (_, i) => (i * 89) % COUNT);
+      // rows [5, 101) of the subset against questions [1, 6), in a wider
+      // output than the block needs
+      const stride = 8;
+      const out = new Float64Array(96 * stride), want = new Float64Array(96 * stride);
+      dotBlock(m, dim, rows, 5, 101, qs, 1, 6, want, stride);
+      simdBlockScorer!(m, dim, rows, 5, 101, qs, 1, 6, out, stride);
+      assertClose(out, want, "out");
+    },
+  });
+}
+
+Deno.test({
+  name: "SIMD scorer rejects a dimension not divisible by 4",
+  ignore: !simdScorer,
+  fn() {
+    const out = new Float32Array(1);
+    assertThrows(
+      () => simdScorer!(new Float32Array(6), 6, 1, new Float32Array(6), out, out),
+      Error,
+      "divisible by 4",
+    );
+  },
+});
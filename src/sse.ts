@@ -0,0 +1,32 @@
+/**
+ * Minimal server-sent events reader, for streamed completions.
+ *
+ * Yields the `data` of each event (multi-line data joined with "\n"), in
+ * order. Event names, ids and comments are skipped; the payload formats
+ * Tieto reads (OpenAI, Anthropic, llama.cpp) are all told apart by their
+ * JSON alone.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { TextLineStream } from "https://deno.land/std@0.204.0/streams/text_line_stream.ts";
+
+export async function* sseData(body: ReadableStream<Uint8Array>): AsyncGenerator<string> {
+  const lines = body
+    .pipeThrough(new TextDecoderStream())
+    .pipeThrough(new TextLineStream());
+  let data: string[] = [];
+  for await (const line of lines) {
+    // a blank line ends the event
+    if (!line) {
+      if (data.length) yield data.join("\n");
+      data = [];
+      continue;
+    }
+    if (line.startsWith("data:")) {
+      data.push(line.slice(line.startsWith("data: ") ? 6 : 5));
+    }
+  }
+  if (data.length) yield data.join("\n");
+}
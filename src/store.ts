@@ -0,0 +1,616 @@
+/**
+ * Binary segment store for Tieto.
+ *
+ * Every ingested document gets a "segment" in the topic's memory directory:
+ *
+ *   {name}.vec        header + contiguous little-endian Float32 rows,
+ *                     followed by one Float32 L2 norm per row
+ *   {name}.qvec       optional int8 / binary quantized rows (see quant.ts),
+ *                     with the same norms; when it's present the .vec file
+ *                     may be left out entirely
+ *   {name}.meta.json  sidecar with the frontmatter of each source document,
+ *                     stored once, and one entry per row, in row order,
+ *                     holding its document's id, plus each row's byte
+ *                     offset in the .text file
+ *   {name}.text       header + the chunk texts, back to back, UTF-8
+ *
+ * The sidecar is the commit point. A write puts the row files and the .text
+ * file in place first and renames the sidecar over the old one last; every
+ * file of one write carries the same random generation number, which the
+ * sidecar records along with each file's size. readSegment() reads the
+ * sidecar first and only accepts row files from its generation, so a read
+ * that lands in the middle of a re-ingest retries instead of pairing new
+ * rows with old chunks. Row files with no sidecar yet aren't a segment.
+ *
+ * The .vec file is read in one go and viewed as a Float32Array, so search
+ * never parses a float from text. Chunk texts are the one part that isn't
+ * loaded: only the rows a search returns have theirs read, by offset, from
+ * the .text file (see readTexts()). The .jsonl file written next to it stays
+ * around as the human-readable export / interchange format, and is still
+ * loaded when a topic only has JSONL (e.g. indexes from older versions).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { TextLineStream } from "https://deno.land/std@0.204.0/streams/text_line_stream.ts";
+import { computeNorms } from "./kernels.ts";
+import { QuantizedRows, wordsPerRow } from "./quant.ts";
+import type { PrefixRows } from "./matryoshka.ts";
+
+// "TVEC" read as a little-endian u32
+const VEC_MAGIC = 0x43455654;
+// v1: rows only. v2: rows + norms. v3: + generation
+const VEC_VERSION = 3;
+// magic, version, dim, count, generation (u32 each); v1 / v2 have no
+// generation
+const VEC_HEADER_BYTES = 20;
+const VEC_V2_HEADER_BYTES = 16;
+
+// "TQVC" read as a little-endian u32
+const QVEC_MAGIC = 0x43565154;
+// v2 adds the generation
+const QVEC_VERSION = 2;
+// magic, version, kind, dim, count, generation (u32 each); v1 has no
+// generation
+const QVEC_HEADER_BYTES = 24;
+const QVEC_V1_HEADER_BYTES = 20;
+const QVEC_KINDS = { int8: 1, binary: 2 } as const;
+
+// "TTXT" read as a little-endian u32
+const TEXT_MAGIC = 0x54585454;
+const TEXT_VERSION = 1;
+// magic, version, generation (u32 each); .text files of v4 sidecars have
+// no header
+const TEXT_HEADER_BYTES = 12;
+
+export interface Segment {
+  // number of dimensions per row
+  dim: number;
+  // number of rows (chunks)
+  count: number;
+  // count * dim floats, row-major; null when only quantized rows were kept
+  vectors: Float32Array | null;
+  // L2 norm of each (full-precision) row
+  norms: Float32Array;
+  // quantized copy of the rows, if ingest made one
+  quant?: QuantizedRows;
+  // leading dimensions of the rows, for Matryoshka coarse scans; derived
+  // on load when prefixDims is set, never written
+  prefix?: PrefixRows;
+  // chunk texts, when they're in memory (fresh from ingest, JSONL, memory
+  // logs, older sidecars); otherwise `payload` says where they are on disk
+  texts?: string[];
+  // the .text file and each row's byte range in it: row r is
+  // [offsets[r], offsets[r + 1]), counted from the end of its header;
+  // `generation` is what the header must say (undefined: no header)
+  payload?: { path: string; offsets: Float64Array; generation?: number };
+  // frontmatter of the documents the rows came from, one object per
+  // distinct document; docOf[row] indexes into it
+  docs: Record<string, unknown>[];
+  docOf: Uint32Array;
+  // content hash of each chunk ("" when unknown, e.g. older indexes); lets
+  // re-ingest reuse vectors of chunks that didn't change
+  hashes?: string[];
+  // a compacted memory segment: how much of its memory log it holds
+  log?: LogMark;
+}
+
+// How far compaction has folded a memory log (memlog.ts) into its
+// segment: the records before byte `offset` of the log with this
+// generation are in the segment already, and whoever reads that log skips
+// them
+export interface LogMark {
+  generation: number;
+  offset: number;
+}
+
+// v2 (and older) sidecars repeat `meta` in every chunk; v3 has `docs`;
+// v4 moves the texts out to the .text file and keeps their `offsets`; v5
+// records the write's generation and the files that belong to it
+const SIDECAR_VERSION = 5;
+
+interface Sidecar {
+  version: number;
+  dim: number;
+  count: number;
+  // generation stamped on every file of this write
+  generation?: number;
+  // byte size of each file of this write; row files not listed aren't part
+  // of the segment (left over, or about to be removed)
+  files?: { vec?: number; qvec?: number; text?: number };
+  log?: LogMark;
+  docs?: Record<string, unknown>[];
+  // count + 1 byte offsets into the .text file
+  offsets?: number[];
+  chunks: { text?: string; doc?: number; meta?: Record<string, unknown>; hash?: string }[];
+}
+
+// Frontmatter objects by content, so rows with the same metadata share
+// one object (and one doc id) in memory and on disk
+export class DocTable {
+  readonly docs: Record<string, unknown>[] = [];
+  private ids = new Map<string, number>();
+  // JSONL doc id → ours, for records that only reference their document
+  private fileDocs = new Map<number, number>();
+
+  add(meta: Record<string, unknown>): number {
+    const key = JSON.stringify(meta);
+    let id = this.ids.get(key);
+    if (id === undefined) {
+      id = this.docs.length;
+      this.docs.push(meta);
+      this.ids.set(key, id);
+    }
+    return id;
+  }
+
+  // doc id of a JSONL record: by the record's own doc id when it has one
+  // (frontmatter is only on that document's first record), by content
+  // otherwise
+  addRecord(c: JsonlRecord): number {
+    if (c.doc === undefined) return this.add(c.meta ?? {});
+    let id = this.fileDocs.get(c.doc);
+    if (id === undefined) {
+      id = this.add(c.meta ?? {});
+      this.fileDocs.set(c.doc, id);
+    }
+    return id;
+  }
+}
+
+export function vecPath(base: string): string {
+  return `${base}.vec`;
+}
+
+export function qvecPath(base: string): string {
+  return `${base}.qvec`;
+}
+
+export function sidecarPath(base: string): string {
+  return `${base}.meta.json`;
+}
+
+export function textPath(base: string): string {
+  return `${base}.text`;
+}
+
+// Pack a list of embeddings into one contiguous row-major matrix
+export function packVectors(rows: ArrayLike<number>[], dim: number): Float32Array {
+  const out = new Float32Array(rows.length * dim);
+  for (let i = 0; i < rows.length; i++) {
+    if (rows[i].length !== dim) {
+      throw new Error("Vectors must have the same dimension.");
+    }
+    out.set(rows[i], i * dim);
+  }
+  return out;
+}
+
+// write to a temp file and rename, so a reader never sees half a segment
+export async function writeAtomic(path: string, data: Uint8Array): Promise<void> {
+  const tmp = `${path}.tmp`;
+  await Deno.writeFile(tmp, data);
+  await Deno.rename(tmp, path);
+}
+
+const bytesOf = (a: ArrayBufferView) =>
+  new Uint8Array(a.buffer, a.byteOffset, a.byteLength);
+
+// remove a file if it's there
+async function removeStale(path: string): Promise<void> {
+  try {
+    await Deno.remove(path);
+  } catch (e) {
+    if (!(e instanceof Deno.errors.NotFound)) throw e;
+  }
+}
+
+function encodeVec(seg: Segment, vectors: Float32Array, generation: number): Uint8Array {
+  const bytes = new Uint8Array(
+    VEC_HEADER_BYTES + vectors.byteLength + seg.norms.byteLength,
+  );
+  const header = new DataView(bytes.buffer);
+  header.setUint32(0, VEC_MAGIC, true);
+  header.setUint32(4, VEC_VERSION, true);
+  header.setUint32(8, seg.dim, true);
+  header.setUint32(12, seg.count, true);
+  header.setUint32(16, generation, true);
+  bytes.set(bytesOf(vectors), VEC_HEADER_BYTES);
+  bytes.set(bytesOf(seg.norms), VEC_HEADER_BYTES + vectors.byteLength);
+  return bytes;
+}
+
+function encodeQvec(seg: Segment, quant: QuantizedRows, generation: number): Uint8Array {
+  const parts: ArrayBufferView[] = quant.kind === "int8"
+    ? [seg.norms, quant.scales!, quant.codes!]
+    : [seg.norms, quant.bits!];
+  const bytes = new Uint8Array(
+    QVEC_HEADER_BYTES + parts.reduce((n, p) => n + p.byteLength, 0),
+  );
+  const header = new DataView(bytes.buffer);
+  header.setUint32(0, QVEC_MAGIC, true);
+  header.setUint32(4, QVEC_VERSION, true);
+  header.setUint32(8, QVEC_KINDS[quant.kind], true);
+  header.setUint32(12, seg.dim, true);
+  header.setUint32(16, seg.count, true);
+  header.setUint32(20, generation, true);
+  let at = QVEC_HEADER_BYTES;
+  for (const part of parts) {
+    bytes.set(bytesOf(part), at);
+    at += part.byteLength;
+  }
+  return bytes;
+}
+
+export async function writeSegment(base: string, seg: Segment): Promise<void> {
+  if (!seg.texts) throw new Error(`Segment texts are not loaded: ${base}`);
+  const encoder = new TextEncoder();
+  const encoded = seg.texts.map((text) => encoder.encode(text));
+  const offsets = [0];
+  for (const bytes of encoded) offsets.push(offsets[offsets.length - 1] + bytes.length);
+  const generation = crypto.getRandomValues(new Uint32Array(1))[0];
+  const payload = new Uint8Array(TEXT_HEADER_BYTES + offsets[offsets.length - 1]);
+  const header = new DataView(payload.buffer);
+  header.setUint32(0, TEXT_MAGIC, true);
+  header.setUint32(4, TEXT_VERSION, true);
+  header.setUint32(8, generation, true);
+  encoded.forEach((bytes, i) => payload.set(bytes, TEXT_HEADER_BYTES + offsets[i]));
+
+  const qvec = seg.quant ? encodeQvec(seg, seg.quant, generation) : null;
+  const vec = seg.vectors ? encodeVec(seg, seg.vectors, generation) : null;
+  const sidecar: Sidecar = {
+    version: SIDECAR_VERSION,
+    dim: seg.dim,
+    count: seg.count,
+    generation,
+    files: { vec: vec?.byteLength, qvec: qvec?.byteLength, text: payload.byteLength },
+    log: seg.log,
+    docs: seg.docs,
+    offsets,
+    chunks: seg.texts.map((_, i) => ({
+      doc: seg.docOf[i],
+      hash: seg.hashes?.[i] || undefined,
+    })),
+  };
+
+  // everything else first, the sidecar last: until it's renamed into
+  // place, readers keep seeing the previous write (and retry if they catch
+  // its row files already replaced). Files the new sidecar doesn't list go
+  // only once nothing refers to them.
+  if (qvec) await writeAtomic(qvecPath(base), qvec);
+  if (vec) await writeAtomic(vecPath(base), vec);
+  await writeAtomic(textPath(base), payload);
+  await writeAtomic(
+    sidecarPath(base),
+    encoder.encode(JSON.stringify(sidecar)),
+  );
+  if (!qvec) await removeStale(qvecPath(base));
+  if (!vec) await removeStale(vecPath(base));
+}
+
+// view floats in place when aligned, otherwise take one copy
+function floatView(bytes: Uint8Array, at: number, length: number): Float32Array {
+  const start = bytes.byteOffset + at;
+  return start % 4 === 0
+    ? new Float32Array(bytes.buffer, start, length)
+    : new Float32Array(bytes.slice(at, at + length * 4).buffer);
+}
+
+// null if the file isn't there
+async function readOptional(path: string): Promise<Uint8Array | null> {
+  try {
+    return await Deno.readFile(path);
+  } catch (e) {
+    if (e instanceof Deno.errors.NotFound) return null;
+    throw e;
+  }
+}
+
+function decodeVec(bytes: Uint8Array, path: string) {
+  // the shortest header; the version says how long this one really is
+  if (bytes.byteLength < VEC_V2_HEADER_BYTES) {
+    throw new Error(`Truncated vector file: ${path}`);
+  }
+  const header = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  if (header.getUint32(0, true) !== VEC_MAGIC) {
+    throw new Error(`Not a Tieto vector file: ${path}`);
+  }
+  const version = header.getUint32(4, true);
+  if (version < 1 || version > VEC_VERSION) {
+    throw new Error(`Unsupported vector file version ${version}: ${path}`);
+  }
+  const dim = header.getUint32(8, true);
+  const count = header.getUint32(12, true);
+  const headerBytes = version >= 3 ? VEC_HEADER_BYTES : VEC_V2_HEADER_BYTES;
+  const rowBytes = count * dim * 4;
+  const normBytes = version >= 2 ? count * 4 : 0;
+  if (bytes.byteLength < headerBytes + rowBytes + normBytes) {
+    throw new Error(`Truncated vector file: ${path}`);
+  }
+  const generation = version >= 3 ? header.getUint32(16, true) : undefined;
+
+  const vectors = floatView(bytes, headerBytes, count * dim);
+  // v1 files predate stored norms; work them out once on load
+  const norms = version >= 2
+    ? floatView(bytes, headerBytes + rowBytes, count)
+    : computeNorms(vectors, dim, count);
+  return { dim, count, vectors, norms, generation };
+}
+
+function decodeQvec(bytes: Uint8Array, path: string) {
+  // a v1 header is the shortest; the version decides the real size
+  if (bytes.byteLength < QVEC_V1_HEADER_BYTES) {
+    throw new Error(`Truncated quantized vector file: ${path}`);
+  }
+  const header = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  if (header.getUint32(0, true) !== QVEC_MAGIC) {
+    throw new Error(`Not a Tieto quantized vector file: ${path}`);
+  }
+  const version = header.getUint32(4, true);
+  if (version < 1 || version > QVEC_VERSION) {
+    throw new Error(`Unsupported quantized vector file version ${version}: ${path}`);
+  }
+  const kind = header.getUint32(8, true) === QVEC_KINDS.int8 ? "int8" : "binary";
+  const dim = header.getUint32(12, true);
+  const count = header.getUint32(16, true);
+  const headerBytes = version >= 2 ? QVEC_HEADER_BYTES : QVEC_V1_HEADER_BYTES;
+  const payload = kind === "int8"
+    ? count * 8 + count * dim
+    : count * 4 + count * wordsPerRow(dim) * 4;
+  if (bytes.byteLength < headerBytes + payload) {
+    throw new Error(`Truncated quantized vector file: ${path}`);
+  }
+  const generation = version >= 2 ? header.getUint32(20, true) : undefined;
+
+  const norms = floatView(bytes, headerBytes, count);
+  let at = headerBytes + count * 4;
+  const quant: QuantizedRows = { kind, dim, count };
+  if (kind === "int8") {
+    quant.scales = floatView(bytes, at, count);
+    at += count * 4;
+    quant.codes = new Int8Array(bytes.buffer, bytes.byteOffset + at, count * dim);
+  } else {
+    const words = count * wordsPerRow(dim);
+    const start = bytes.byteOffset + at;
+    quant.bits = start % 4 === 0
+      ? new Uint32Array(bytes.buffer, start, words)
+      : new Uint32Array(bytes.slice(at, at + words * 4).buffer);
+  }
+  return { dim, count, norms, quant, generation };
+}
+
+// the sidecar and a row or text file come from different writes: a
+// re-ingest is between renames, and reading again will find them consistent
+export class TornRead extends Error {}
+
+// attempts, and the pause between them, before a torn read is an error
+export const READ_ATTEMPTS = 5;
+export const READ_RETRY_MS = 20;
+
+export async function readSegment(base: string): Promise<Segment> {
+  for (let attempt = 1;; attempt++) {
+    try {
+      return await readSegmentOnce(base);
+    } catch (e) {
+      if (!(e instanceof TornRead) || attempt >= READ_ATTEMPTS) throw e;
+      await new Promise((resolve) => setTimeout(resolve, READ_RETRY_MS));
+    }
+  }
+}
+
+async function readSegmentOnce(base: string): Promise<Segment> {
+  // the sidecar first: it says which row files belong to it
+  const sidecar: Sidecar = JSON.parse(await Deno.readTextFile(sidecarPath(base)));
+  const { files, generation } = sidecar;
+  const rowFile = async (path: string, listed: number | undefined) => {
+    if (files && listed === undefined) return null;
+    const bytes = await readOptional(path);
+    if (files && (!bytes || bytes.byteLength !== listed)) {
+      throw new TornRead(`Row file does not match its sidecar: ${path}`);
+    }
+    return bytes;
+  };
+  const [vecBytes, qvecBytes] = await Promise.all([
+    rowFile(vecPath(base), files?.vec),
+    rowFile(qvecPath(base), files?.qvec),
+  ]);
+
+  const full = vecBytes ? decodeVec(vecBytes, vecPath(base)) : null;
+  const quantized = qvecBytes ? decodeQvec(qvecBytes, qvecPath(base)) : null;
+  for (const [decoded, path] of [[full, vecPath(base)], [quantized, qvecPath(base)]] as const) {
+    if (decoded && files && decoded.generation !== generation) {
+      throw new TornRead(`Row file does not match its sidecar: ${path}`);
+    }
+  }
+  const rows = full ?? quantized;
+  if (!rows) throw new Error(`No vector file for segment: ${base}`);
+  if (full && quantized && (full.dim !== quantized.dim || full.count !== quantized.count)) {
+    throw new Error(`Quantized rows do not match vector file: ${qvecPath(base)}`);
+  }
+
+  // (older sidecars list no files, so this is all there is to go on)
+  if (sidecar.count !== rows.count || sidecar.dim !== rows.dim) {
+    throw new TornRead(`Sidecar does not match vector file: ${sidecarPath(base)}`);
+  }
+
+  let docs = sidecar.docs;
+  let docOf: Uint32Array;
+  if (docs) {
+    docOf = Uint32Array.from(sidecar.chunks, (c) => c.doc ?? 0);
+  } else {
+    // older sidecars: fold the per-chunk copies back into one per document
+    const table = new DocTable();
+    docOf = Uint32Array.from(sidecar.chunks, (c) => table.add(c.meta ?? {}));
+    docs = table.docs;
+  }
+
+  return {
+    dim: rows.dim,
+    count: rows.count,
+    vectors: full?.vectors ?? null,
+    norms: rows.norms,
+    quant: quantized?.quant,
+    // texts stay on disk unless the sidecar predates the .text file
+    texts: sidecar.offsets ? undefined : sidecar.chunks.map((c) => c.text ?? ""),
+    payload: sidecar.offsets
+      ? {
+        path: textPath(base),
+        offsets: Float64Array.from(sidecar.offsets),
+        generation: sidecar.files ? generation : undefined,
+      }
+      : undefined,
+    docs,
+    docOf,
+    hashes: sidecar.chunks.map((c) => c.hash ?? ""),
+    log: sidecar.log,
+  };
+}
+
+// Texts of some rows of a segment, in the order given: from memory when
+// the segment has them, otherwise one positioned read per row from its
+// .text file
+export async function readTexts(seg: Segment, rows: ArrayLike<number>): Promise<string[]> {
+  if (seg.texts) return Array.from(rows, (r) => seg.texts![r]);
+  const { path, offsets, generation } = seg.payload!;
+  const file = await Deno.open(path, { read: true });
+  const readAt = async (at: number, length: number) => {
+    const bytes = new Uint8Array(length);
+    await file.seek(at, Deno.SeekMode.Start);
+    for (let got = 0; got < length;) {
+      const n = await file.read(bytes.subarray(got));
+      if (n === null) throw new Error(`Truncated text file: ${path}`);
+      got += n;
+    }
+    return bytes;
+  };
+  try {
+    // re-ingested since the sidecar was read (another write's generation,
+    // or another length): a search reloads the segment and runs again
+    const start = generation === undefined ? 0 : TEXT_HEADER_BYTES;
+    let matches = (await file.stat()).size === start + offsets[offsets.length - 1];
+    if (matches && generation !== undefined) {
+      const header = new DataView((await readAt(0, TEXT_HEADER_BYTES)).buffer);
+      matches = header.getUint32(0, true) === TEXT_MAGIC &&
+        header.getUint32(4, true) === TEXT_VERSION &&
+        header.getUint32(8, true) === generation;
+    }
+    if (!matches) throw new TornRead(`Text file does not match its sidecar: ${path}`);
+
+    const decoder = new TextDecoder();
+    const texts: string[] = [];
+    for (let i = 0; i < rows.length; i++) {
+      const r = rows[i];
+      texts.push(decoder.decode(await readAt(start + offsets[r], offsets[r + 1] - offsets[r])));
+    }
+    return texts;
+  } finally {
+    file.close();
+  }
+}
+
+// bytes readTexts() reads from disk for these rows
+export function textBytes(seg: Segment, rows: ArrayLike<number>): number {
+  if (!seg.payload) return 0;
+  const { offsets } = seg.payload;
+  let bytes = 0;
+  for (let i = 0; i < rows.length; i++) bytes += offsets[rows[i] + 1] - offsets[rows[i]];
+  return bytes;
+}
+
+// frontmatter of a segment row
+export function metaOf(seg: Segment, row: number): Record<string, unknown> {
+  return seg.docs[seg.docOf[row]];
+}
+
+// one line of a .jsonl index / export
+export interface JsonlRecord {
+  text: string;
+  embedding: number[];
+  // the record's document within the file; `meta` is only written on the
+  // first record of each document. Files without doc ids (older exports,
+  // memory logs) carry `meta` on every record.
+  doc?: number;
+  meta?: Record<string, unknown>;
+  hash?: string;
+}
+
+// Records of a .jsonl file, one line at a time, so nothing ever holds the
+// whole file (or an array of its lines) in memory
+export async function* streamJsonl(path: string): AsyncGenerator<JsonlRecord> {
+  const file = await Deno.open(path, { read: true });
+  const lines = file.readable
+    .pipeThrough(new TextDecoderStream())
+    .pipeThrough(new TextLineStream());
+  for await (const line of lines) {
+    if (line.trim()) yield JSON.parse(line);
+  }
+}
+
+// Write records as JSONL, one line at a time
+export async function writeJsonl(
+  path: string,
+  records: Iterable<JsonlRecord>,
+): Promise<void> {
+  const tmp = `${path}.tmp`;
+  const file = await Deno.open(tmp, { write: true, create: true, truncate: true });
+  const writer = file.writable.getWriter();
+  const encoder = new TextEncoder();
+  try {
+    let first = true;
+    for (const record of records) {
+      await writer.write(encoder.encode((first ? "" : "\n") + JSON.stringify(record)));
+      first = false;
+    }
+  } finally {
+    await writer.close();
+  }
+  await Deno.rename(tmp, path);
+}
+
+// Load a legacy / exported .jsonl index into the same in-memory shape.
+// Rows go straight into a growing Float32Array as lines stream in.
+export async function readJsonlSegment(path: string): Promise<Segment> {
+  let vectors = new Float32Array(0);
+  let dim = 0;
+  let count = 0;
+  const texts: string[] = [];
+  const table = new DocTable();
+  let docOf = new Uint32Array(64);
+  const hashes: string[] = [];
+  for await (const c of streamJsonl(path)) {
+    if (!count) {
+      dim = c.embedding.length;
+      vectors = new Float32Array(dim * 64);
+    }
+    if (c.embedding.length !== dim) {
+      throw new Error("Vectors must have the same dimension.");
+    }
+    if ((count + 1) * dim > vectors.length) {
+      const grown = new Float32Array(vectors.length * 2);
+      grown.set(vectors);
+      vectors = grown;
+    }
+    if (count === docOf.length) {
+      const grown = new Uint32Array(docOf.length * 2);
+      grown.set(docOf);
+      docOf = grown;
+    }
+    vectors.set(c.embedding, count * dim);
+    texts.push(c.text);
+    docOf[count] = table.addRecord(c);
+    hashes.push(c.hash ?? "");
+    count++;
+  }
+  vectors = vectors.slice(0, count * dim);
+  return {
+    dim,
+    count,
+    vectors,
+    norms: computeNorms(vectors, dim, count),
+    texts,
+    docs: table.docs,
+    docOf: docOf.slice(0, count),
+    hashes,
+  };
+}
@@ -0,0 +1,146 @@
+/**
+ * Tests for the binary segment store (store.ts).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assertEquals, assertRejects } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { quantize } from "./quant.ts";
+import {
+  qvecPath,
+  readSegment,
+  readTexts,
+  Segment,
+  sidecarPath,
+  TornRead,
+  vecPath,
+  writeSegment,
+} from "./store.ts";
+import { randomRows, segmentOf, withTempDir } from "./test_util.ts";
+
+async function roundTrip(seg: Segment): Promise<Segment> {
+  return await withTempDir(async (dir) => {
+    const base = join(dir, "doc");
+    await writeSegment(base, seg);
+    const back = await readSegment(base);
+    // texts stay on disk; read them while the file is still there
+    assertEquals(back.texts, undefined);
+    const rows = Array.from({ length: back.count }, (_, r) => r);
+    return { ...back, texts: await readTexts(back, rows) };
+  });
+}
+
+function assertSameSegment(actual: Segment, expected: Segment) {
+  assertEquals(actual.dim, expected.dim);
+  assertEquals(actual.count, expected.count);
+  assertEquals(actual.vectors, expected.vectors);
+  assertEquals(actual.norms, expected.norms);
+  assertEquals(actual.quant, expected.quant);
+  assertEquals(actual.texts, expected.texts);
+  assertEquals(actual.docs, expected.docs);
+  assertEquals(actual.docOf, expected.docOf);
+  assertEquals(actual.hashes, expected.hashes);
+}
+
+Deno.test("writeSegment / readSegment round-trip", async () => {
+  const seg = segmentOf(randomRows(37, 12, 1), 12);
+  assertSameSegment(await roundTrip(seg), seg);
+});
+
+Deno.test("writeSegment / readSegment round-trip an empty segment", async () => {
+  const seg = segmentOf(new Float32Array(0), 8);
+  assertSameSegment(await roundTrip(seg), seg);
+});
+
+for (const kind of ["int8", "binary"] as const) {
+  Deno.test(`writeSegment / readSegment round-trip ${kind} rows`, async () => {
+    const seg = segmentOf(randomRows(20, 40, 2), 40);
+    seg.quant = quantize(kind, seg.vectors!, 40, 20);
+    assertSameSegment(await roundTrip(seg), seg);
+  });
+
+  Deno.test(`writeSegment / readSegment round-trip ${kind} rows only`, async () => {
+    const seg = segmentOf(randomRows(20, 40, 3), 40);
+    seg.quant = quantize(kind, seg.vectors!, 40, 20);
+    seg.vectors = null;
+    assertSameSegment(await roundTrip(seg), seg);
+  });
+}
+
+Deno.test("readTexts reads the rows asked for, in that order", async () => {
+  await withTempDir(async (dir) => {
+    const base = join(dir, "doc");
+    const seg = segmentOf(randomRows(9, 4, 4), 4);
+    await writeSegment(base, seg);
+    const back = await readSegment(base);
+    assertEquals(await readTexts(back, [7, 2, 2, 5]), [7, 2, 2, 5].map((r) => seg.texts![r]));
+    assertEquals(await readTexts(back, []), []);
+  });
+});
+
+Deno.test("readTexts rejects a text file rewritten since the sidecar was read", async () => {
+  await withTempDir(async (dir) => {
+    const base = join(dir, "doc");
+    const seg = segmentOf(randomRows(4, 4, 6), 4);
+    await writeSegment(base, seg);
+    const back = await readSegment(base);
+    // same texts, same size: only the generation has changed
+    await writeSegment(base, seg);
+    await assertRejects(() => readTexts(back, [1]), TornRead, "Text file does not match");
+  });
+});
+
+Deno.test("writeSegment needs the texts in memory", async () => {
+  const seg = segmentOf(randomRows(2, 4, 5), 4);
+  seg.texts = undefined;
+  await assertRejects(() => writeSegment("unused", seg), Error, "Segment texts are not loaded");
+});
+
+Deno.test("readSegment rejects a truncated vector file", async () => {
+  await withTempDir(async (dir) => {
+    const base = join(dir, "doc");
+    await writeSegment(base, segmentOf(randomRows(8, 4, 2), 4));
+    const bytes = await Deno.readFile(vecPath(base));
+    await Deno.writeFile(vecPath(base), bytes.subarray(0, bytes.byteLength - 16));
+    await assertRejects(() => readSegment(base), Error, "Row file does not match its sidecar");
+  });
+});
+
+Deno.test("readSegment rejects a vector file from another write", async () => {
+  await withTempDir(async (dir) => {
+    const base = join(dir, "doc");
+    await writeSegment(base, segmentOf(randomRows(8, 4, 2), 4));
+    const old = await Deno.readFile(vecPath(base));
+    // same shape, so only the generation tells them apart
+    await writeSegment(base, segmentOf(randomRows(8, 4, 3), 4));
+    await Deno.writeFile(vecPath(base), old);
+    await assertRejects(() => readSegment(base), Error, "Row file does not match its sidecar");
+  });
+});
+
+// little-endian u32 header words, the way older versions wrote them
+const header = (...words: number[]) => {
+  const bytes = new Uint8Array(words.length * 4);
+  words.forEach((w, i) => new DataView(bytes.buffer).setUint32(i * 4, w, true));
+  return bytes;
+};
+
+Deno.test("readSegment reads header-only files from older versions", async () => {
+  await withTempDir(async (dir) => {
+    const base = join(dir, "doc");
+    // a v3 sidecar lists no files; an empty v1 qvec is just its 20-byte header
+    const sidecar = { version: 3, dim: 8, count: 0, docs: [], chunks: [] };
+    await Deno.writeTextFile(sidecarPath(base), JSON.stringify(sidecar));
+    await Deno.writeFile(qvecPath(base), header(0x43565154, 1, 1, 8, 0));
+    let seg = await readSegment(base);
+    assertEquals([seg.dim, seg.count, seg.quant?.kind], [8, 0, "int8"]);
+
+    // and an empty v2 vec its 16-byte one
+    await Deno.remove(qvecPath(base));
+    await Deno.writeFile(vecPath(base), header(0x43455654, 2, 8, 0));
+    seg = await readSegment(base);
+    assertEquals([seg.dim, seg.count, seg.vectors?.length], [8, 0, 0]);
+  });
+});
@@ -0,0 +1,48 @@
+/**
+ * Fixtures shared by the tests (the *_test.ts files next to this one).
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { lcg } from "./ivf.ts";
+import { computeNorms } from "./kernels.ts";
+import { DocTable, Segment } from "./store.ts";
+
+// `count` rows of `dim` floats in [-1, 1); the same seed gives the same rows
+export function randomRows(count: number, dim: number, seed: number): Float32Array {
+  const rand = lcg(seed);
+  return Float32Array.from({ length: count * dim }, () => rand() * 2 - 1);
+}
+
+// A segment over `vectors`: one text per row (multi-byte on some, so byte
+// and character offsets differ), a content hash per row, and rows taking
+// turns between two documents
+export function segmentOf(vectors: Float32Array, dim: number): Segment {
+  const count = vectors.length / dim;
+  const docs = new DocTable();
+  const docOf = Uint32Array.from(
+    { length: count },
+    (_, i) => docs.add({ part: i % 2 ? "odd" : "even" }),
+  );
+  return {
+    dim,
+    count,
+    vectors,
+    norms: computeNorms(vectors, dim, count),
+    texts: Array.from({ length: count }, (_, i) => `chunk ${i} ${"äö€".repeat(i % 3)}`),
+    docs: docs.docs,
+    docOf,
+    hashes: Array.from({ length: count }, (_, i) => `hash${i}`),
+  };
+}
+
+// Run `fn` in a fresh temporary directory, removed afterwards
+export async function withTempDir<T>(fn: (dir: string) => Promise<T>): Promise<T> {
+  const dir = await Deno.makeTempDir({ prefix: "tieto_test_" });
+  try {
+    return await fn(dir);
+  } finally {
+    await Deno.remove(dir, { recursive: true });
+  }
+}
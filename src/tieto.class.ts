@@ -12,16 +12,66 @@
  */
 
 import { walk } from "https://deno.land/std@0.204.0/fs/walk.ts";
-import { join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { basename, dirname, join } from "https://deno.land/std@0.204.0/path/mod.ts";
 import { extract } from "https://deno.land/std@0.204.0/front_matter/yaml.ts";
+import {
+  DocTable,
+  JsonlRecord,
+  metaOf,
+  packVectors,
+  READ_ATTEMPTS,
+  READ_RETRY_MS,
+  readJsonlSegment,
+  readSegment,
+  readTexts,
+  Segment,
+  sidecarPath,
+  streamJsonl,
+  textBytes,
+  textPath,
+  TornRead,
+  writeJsonl,
+  writeSegment,
+} from "./store.ts";
+import {
+  BlockScorer,
+  computeNorms,
+  cosineFromDot,
+  dotAndSqDist,
+  dotBlock,
+  RowScorer,
+  rowNorm,
+  scoreRows,
+  TopK,
+} from "./kernels.ts";
+import { createSimdBlockScorer, createSimdScorer } from "./simd.ts";
+import { EmbeddingCache } from "./embedcache.ts";
+import { EmbeddingBatcher } from "./batcher.ts";
+import { createHttpClient, HttpClient } from "./http.ts";
+import { sseData } from "./sse.ts";
+import { estimateTokens, packContext } from "./pack.ts";
+import { CHUNK_SIZES, chunkText, ChunkUnit } from "./chunker.ts";
+import { LogTail, MemoryLog } from "./memlog.ts";
+import { formatMetrics, MetricsHook, newMetrics, QueryMetrics, stopwatch } from "./metrics.ts";
+import { batchScratch, scanSegment, scanSegmentBatch, shortlisted } from "./scan.ts";
+import { ScanPool, ScanResult, shareSegment } from "./pool.ts";
+import { createLimiter } from "./limit.ts";
+import { dequantizeRow, QuantKind, quantize } from "./quant.ts";
+import { buildIvf, IvfIndex, probeLists, readIvf, writeIvf } from "./ivf.ts";
+import {
+  readStats,
+  sampleStats,
+  Thresholds,
+  thresholdsAt,
+  TopicStats,
+  writeStats,
+} from "./calibrate.ts";
+import { Compiled, compileFilters, FilterExpr, Op } from "./filters.ts";
+import { intersectRows, MetaIndex } from "./metaindex.ts";
+import { truncateRows } from "./matryoshka.ts";
 
-// for filter parsing
-type Op = "=" | ">=" | "<=" | ">" | "<" | "in";
-interface Filter {
-  key: string;
-  op: Op;
-  value: string | string[];
-}
+export type { Filter, FilterExpr } from "./filters.ts";
+export type { QueryMetrics } from "./metrics.ts";
 
 export interface TietoConfig {
   // The first two options here are particularly important, and are designed
@@ -47,8 +97,7 @@ export interface TietoConfig {
   // close they have to be in literal meaning in order to get through the sieve (Euclidean
   // distance). 
   //
-  // Eventually, the next two settings will be auto-sensing based on corpus, but that's quite
-  // a challenge for such a tiny class.
+  // The next two settings can also sense the corpus: see thresholdPercentile below.
   //
   // For cosine similiarity, a larger value is stronger signal (higher similarity = stronger 
   // result). 0.6 is noisy, 0.7 is good for fuzzy docs search, 0.8+ is very scrutinizing.
@@ -60,6 +109,12 @@ export interface TietoConfig {
   // to corpus size and language used, so you may need to play with it.
   // default: 0.8
   maxDistance?: number;
+  // Derive both of the above per topic instead, from the similarity / distance of
+  // sampled chunk pairs recorded in the topic's manifest.json (written by ingest-dir
+  // and `tieto index`). 99 keeps chunks closer to the question than 99% of pairs in
+  // the topic are to each other. Topics without a manifest use the fixed values.
+  // default: 0 (off)
+  thresholdPercentile?: number;
 
   // 
   // Now, the boring no-math configuration options:
@@ -73,14 +128,117 @@ export interface TietoConfig {
   debug?: boolean;
   // embedding completion URL (environment, then localhost v1/embeddings by default)
   embeddingUrl?: string;
+  // embedding model name, sent as `model` when set (hosted APIs need it).
+  // Also part of each chunk's content hash, so changing it re-embeds.
+  embeddingModel?: string;
   // completion URL (environment, then localhost v1/completion by default)
   completionUrl?: string;
   // Your (OpenAPI, Claude, Featherless, OpenRouter or (whatever)) bearer token
   apiKey?: string;
-  // how big of pieces should documents be broken up into? Default is 1k
+  // how documents are cut into chunks: "chars" or "tokens" packs whole
+  // sentences into chunks of up to chunkSize characters / estimated tokens,
+  // breaking at paragraphs and before markdown headings; "lines" takes
+  // chunkSize non-empty lines per chunk, like older versions did.
+  // Part of each chunk's content hash, as are the two below.
+  // default: "chars"
+  chunkBy?: ChunkUnit;
+  // how big of pieces should documents be broken up into, in chunkBy
+  // units. default: 1000 chars, 256 tokens or 3 lines
   chunkSize?: number;
+  // how much of the end of each chunk (whole sentences, in chunkBy units)
+  // is repeated at the start of the next one, so passages on a boundary
+  // are found from either side. Ignored for lines. default: chunkSize / 8
+  chunkOverlap?: number;
+  // .jsonl-only documents bigger than this many bytes aren't kept in memory;
+  // search streams through them line by line on every query instead.
+  // default: 64 MiB
+  streamJsonlAbove?: number;
+  // how many question embeddings to keep in memory, so repeated questions
+  // skip the embedding server. 0 turns the cache off. default: 1000
+  embeddingCacheSize?: number;
+  // also keep cached question embeddings on disk, under
+  // {topicsDirectory}/.embedding-cache, so they survive restarts.
+  // default: false
+  persistEmbeddingCache?: boolean;
+  // milliseconds an embedding / completion request may go without
+  // receiving anything (headers or body) before it's aborted and retried.
+  // A non-streamed completion sends nothing until it's done, so leave room
+  // for the whole generation. default: 120000
+  requestTimeout?: number;
+  // how many times a request that failed transiently (network error,
+  // timeout, 429 or 5xx gateway error) is retried, with jittered backoff
+  // in between. default: 3
+  requestRetries?: number;
+  // embedding / completion requests on the wire at once, across the whole
+  // instance. default: 8
+  maxInFlightRequests?: number;
+  // token budget for the whole prompt (instructions, context and question).
+  // The best chunks are packed in by score until it's full, deduplicated
+  // and cut at a paragraph / line / sentence boundary. default: 0 (no limit)
+  contextTokens?: number;
+  // llama.cpp-style /tokenize endpoint for exact token counts when packing;
+  // without one, tokens are estimated from the text. default: ""
+  tokenizerUrl?: string;
+  // remember(): appends arriving within this many milliseconds of each
+  // other are written with a single disk sync. default: 20
+  memoryFlushMs?: number;
+  // remember(): once a topic's memory log is bigger than this many bytes,
+  // it's compacted into a binary segment in the background. 0 leaves
+  // compaction to compactMemory(). default: 8 MiB
+  compactMemoryAbove?: number;
+  // called with the timings and counts of every search / query (see
+  // metrics.ts), e.g. to export them as OpenTelemetry spans. Exceptions
+  // it throws are logged, never passed on to the query. default: null
+  onMetrics?: MetricsHook | null;
+  // how many texts to send per embedding request during ingest. default: 32
+  embeddingBatchSize?: number;
+  // questions (and remember() texts) to embed that arrive within this many
+  // milliseconds of each other go out as one batched request, up to
+  // embeddingBatchSize inputs. Identical texts already waiting or in
+  // flight share a request either way. 0 sends each right away.
+  // default: 2
+  embeddingBatchWindowMs?: number;
+  // embedding requests in flight at once when ingesting a whole topic
+  // with ingestTopic() / `tieto ingest-dir`. default: 4
+  ingestConcurrency?: number;
   // maximum number of results to show
   maxResults?: number;
+  // IVF index: how many of the nearest lists to scan per query. Higher is
+  // better recall and slower; nlist scans everything. Only used for topics
+  // that have been indexed with `tieto index <topic>`. default: 8
+  nprobe?: number;
+  // IVF index: number of lists (k-means clusters) to build. default: 0,
+  // which picks sqrt(number of chunks)
+  ivfLists?: number;
+  // Store a quantized copy of each embedding at ingest: "int8" (one byte per
+  // dimension plus a per-vector scale) or "binary" (one sign bit per
+  // dimension). Search uses it for a fast first pass and rescores the best
+  // candidates with the full vectors, if they're kept. default: "none"
+  quantization?: "none" | QuantKind;
+  // With quantization on, also keep the Float32 vectors (and JSONL export).
+  // Turn off to save the most disk and RAM, at some cost to ranking
+  // precision. default: true
+  keepFullPrecision?: boolean;
+  // How many quantized candidates per result get rescored in full
+  // precision (maxResults * rescoreFactor). default: 10
+  rescoreFactor?: number;
+  // Matryoshka coarse search: score every chunk on only the first
+  // prefixDims dimensions of its embedding, then rerank the best
+  // rescoreFactor * maxResults with the full vectors. Only for models
+  // trained that way (Nomic Embed, text-embedding-3); 64–256 is typical,
+  // must be less than the embedding size. Not used on quantized
+  // segments, which have their own first pass. default: 0 (off)
+  prefixDims?: number;
+  // score with the WebAssembly SIMD kernel when the runtime supports it
+  // (falls back to plain JS otherwise). default: true
+  simd?: boolean;
+  // Scan large topics on this many Deno Workers in parallel (resident rows
+  // are kept in shared memory so workers read them without copying). Call
+  // close() when done to stop them. default: 0 (scan on the calling thread)
+  workers?: number;
+  // Only use the workers once a query has at least this many rows to
+  // score; below it, messaging costs more than it saves. default: 50000
+  workerMinRows?: number;
 
   //
   // These control the settings issued to the model for RAG completion only (has no
@@ -96,9 +254,10 @@ export interface TietoConfig {
     // how many tokens should the model generate by default? Responses can exceed or
     // fall short of this - it is a default length to target when generation starts.
     n_predict?: number;
-    // API-specific limits (throw if request would exceed it)
-    // not yet fully working; comprehensive token estimating is planned. Tieto assumes
-    // local models by default (no need for token accounting)
+    // most tokens the model may generate for one answer (sent as-is; hosted APIs
+    // stop or reject past it). It doesn't count toward contextTokens, which only
+    // budgets the prompt, so size the two so contextTokens + max_tokens fits the
+    // model's context window. default: 500
     max_tokens?: number;
     // completion model (by name, e.g haiku or gpt-mini)
     // needed if using some third-party AI services (e.g. Claude, ChatGPT)
@@ -108,35 +267,110 @@ export interface TietoConfig {
   };
 }
 
-interface Chunk {
-  text: string;
-  embedding: number[];
+// a document read and chunked, waiting for its embeddings
+interface PreparedDocument {
   meta: Record<string, unknown>;
+  texts: string[];
+  hashes: string[];
+}
+
+// what a search goes over: resident segments plus JSONL files too big to
+// keep in memory
+interface TopicView {
+  segments: ResidentSegment[];
+  streamed: string[];
+  // read from disk to bring the view up to date, plus the streamed files
+  bytesRead: number;
+}
+
+interface ResidentSegment {
+  // path relative to the topic's memory directory, without extension
+  name: string;
+  fingerprint: string;
+  segment: Segment;
+  // set for memory logs, which grow in place
+  tail?: LogTail;
 }
 
-interface ScoredChunk extends Chunk {
+interface ScoredChunk {
+  // topic the chunk was found in (see searchMany())
+  topic: string;
+  text: string;
+  embedding: Float32Array;
+  // frontmatter of the chunk's document
+  meta: Record<string, unknown>;
   score: number;
-  distance?: number;
+  distance: number;
 }
 
 export class Tieto {
   private config: Required<TietoConfig>;
+  // topic → segment base path → loaded segment
+  private resident = new Map<string, Map<string, ResidentSegment>>();
+  // frontmatter index of each resident segment, built when it's loaded
+  private metaIndexes = new WeakMap<Segment, MetaIndex>();
+  private loading = new Map<string, Promise<TopicView>>();
+  // topic → IVF index, if the topic has one
+  private ivf = new Map<string, { fingerprint: string; index: IvfIndex }>();
+  // topic → score statistics from its manifest, if it has one
+  private stats = new Map<string, { fingerprint: string; stats: TopicStats }>();
+  // undefined until first needed, null if WASM SIMD isn't available
+  private simdScorer?: RowScorer | null;
+  private simdBlockScorer?: BlockScorer | null;
+  // started on the first scan big enough to need it
+  private pool?: ScanPool;
+  // question embeddings; null when turned off, undefined until first use
+  private queryCache?: EmbeddingCache | null;
+  private httpClient?: HttpClient;
+  private batcher?: EmbeddingBatcher;
+  // topic → memory log writer, and compactions running in the background
+  private memoryLogs = new Map<string, MemoryLog>();
+  private compacting = new Map<string, Promise<void>>();
 
   constructor(config: TietoConfig = {}) {
     this.config = {
       minSimilarityThreshold: config.minSimilarityThreshold ?? 0.4,
       maxDistance: config.maxDistance ?? 0.8,
+      thresholdPercentile: config.thresholdPercentile ?? 0,
       topicsDirectory: config.topicsDirectory ?? "topics",
       embeddingsDirectory: config.embeddingsDirectory ?? "memory",
       debug: config.debug ??
         (Deno.args.includes("--debug") || Deno.env.get("TIETO_DEBUG") === "1"),
       embeddingUrl: config.embeddingUrl ?? Deno.env.get("TIETO_EMBEDDING_URL") ??
         "http://localhost:8080/v1/embeddings",
+      embeddingModel: config.embeddingModel ?? Deno.env.get("TIETO_EMBEDDING_MODEL") ?? "",
       completionUrl: config.completionUrl ??
         Deno.env.get("TIETO_COMPLETION_URL") ?? "",
       apiKey: config.apiKey ?? Deno.env.get("TIETO_API_KEY") ?? "",
-      chunkSize: config.chunkSize ?? 3,
+      chunkBy: config.chunkBy ?? "chars",
+      chunkSize: config.chunkSize ?? CHUNK_SIZES[config.chunkBy ?? "chars"],
+      chunkOverlap: config.chunkOverlap ??
+        Math.floor((config.chunkSize ?? CHUNK_SIZES[config.chunkBy ?? "chars"]) / 8),
+      streamJsonlAbove: config.streamJsonlAbove ?? 64 * 1024 * 1024,
+      embeddingCacheSize: config.embeddingCacheSize ?? 1000,
+      persistEmbeddingCache: config.persistEmbeddingCache ?? false,
+      requestTimeout: config.requestTimeout ?? 120_000,
+      requestRetries: config.requestRetries ?? 3,
+      maxInFlightRequests: config.maxInFlightRequests ?? 8,
+      contextTokens: config.contextTokens ?? 0,
+      tokenizerUrl: config.tokenizerUrl ??
+        Deno.env.get("TIETO_TOKENIZER_URL") ?? "",
+      memoryFlushMs: config.memoryFlushMs ?? 20,
+      compactMemoryAbove: config.compactMemoryAbove ?? 8 * 1024 * 1024,
+      onMetrics: config.onMetrics ?? null,
+      embeddingBatchSize: config.embeddingBatchSize ?? 32,
+      embeddingBatchWindowMs: config.embeddingBatchWindowMs ?? 2,
+      ingestConcurrency: config.ingestConcurrency ?? 4,
       maxResults: config.maxResults ?? 3,
+      nprobe: config.nprobe ?? 8,
+      ivfLists: config.ivfLists ?? 0,
+      quantization: config.quantization ?? "none",
+      keepFullPrecision: config.keepFullPrecision ?? true,
+      rescoreFactor: config.rescoreFactor ?? 10,
+      prefixDims: config.prefixDims ?? 0,
+      simd: config.simd ?? true,
+      workers: config.workers ?? 0,
+      workerMinRows: config.workerMinRows ?? 50_000,
       completionParams: {
         temperature: 0,
         n_predict: 128,
@@ -150,33 +384,74 @@ export class Tieto {
     if (this.config.debug) console.log("===", ...args);
   }
 
-  // extremely fast comparison
-  private cosineSimilarity(a: number[], b: number[]): number {
-    if (a.length !== b.length) {
-      throw new Error("Vectors must have the same dimension.");
+  // You can modify this to use a third-party embedding model, if you
+  // need to. Single texts (questions) go through the embedding cache.
+  async embed(text: string): Promise<Float32Array> {
+    return (await this.embedQuestion(text))[0];
+  }
+
+  // embed(), and whether the vector came from the cache
+  private async embedQuestion(text: string): Promise<[Float32Array, boolean]> {
+    const cache = this.embeddingCache();
+    const cached = await cache?.get(text);
+    if (cached) {
+      this.logDebug("🗃️  Embedding cache hit");
+      return [cached, true];
     }
-    const dot = a.reduce((s, ai, i) => s + ai * b[i], 0);
-    const na = Math.hypot(...a);
-    const nb = Math.hypot(...b);
-    return dot / (na * nb);
+    const vec = await this.embedOne(text);
+    await cache?.set(text, vec);
+    return [vec, false];
   }
 
-  // differentiate between precise and fuzzy matches
-  // longer distances = fuzzier match
-  private euclideanDistance(a: number[], b: number[]): number {
-    if (a.length !== b.length) {
-      throw new Error("Vectors must have the same dimension.");
+  // one text, coalesced with whatever else is being embedded right now
+  private embedOne(text: string): Promise<Float32Array> {
+    this.batcher ??= new EmbeddingBatcher(
+      (input) => this.requestEmbeddings(input),
+      this.config.embeddingBatchWindowMs,
+      this.config.embeddingBatchSize,
+    );
+    return this.batcher.embed(text);
+  }
+
+  // every embedding and completion request goes through this
+  private http(): HttpClient {
+    this.httpClient ??= createHttpClient({
+      timeout: this.config.requestTimeout,
+      retries: this.config.requestRetries,
+      maxInFlight: this.config.maxInFlightRequests,
+    });
+    return this.httpClient;
+  }
+
+  private embeddingCache(): EmbeddingCache | null {
+    if (this.queryCache === undefined) {
+      const { embeddingCacheSize, persistEmbeddingCache } = this.config;
+      this.queryCache = embeddingCacheSize > 0 || persistEmbeddingCache
+        ? new EmbeddingCache(
+          embeddingCacheSize,
+          this.config.embeddingModel || this.config.embeddingUrl,
+          persistEmbeddingCache
+            ? join(this.config.topicsDirectory, ".embedding-cache")
+            : undefined,
+        )
+        : null;
     }
-    const sumOfSquaredDifferences = a.reduce((sum, ai, i) => {
-      const difference = ai - b[i];
-      return sum + difference * difference;
-    }, 0);
-    return Math.sqrt(sumOfSquaredDifferences);
+    return this.queryCache;
   }
 
-  // You can modify this to use a third-party embedding model, if you
-  // need to.
-  async embed(text: string): Promise<Float32Array> {
+  // Embed several texts with as few round trips as possible: inputs go out
+  // embeddingBatchSize at a time as one OpenAI-style array `input`. The
+  // result is in the same order as `texts`.
+  async embedBatch(texts: string[]): Promise<Float32Array[]> {
+    const out: Float32Array[] = [];
+    const size = Math.max(1, this.config.embeddingBatchSize);
+    for (let i = 0; i < texts.length; i += size) {
+      out.push(...await this.requestEmbeddings(texts.slice(i, i + size)));
+    }
+    return out;
+  }
+
+  private async requestEmbeddings(input: string[]): Promise<Float32Array[]> {
     const headers: Record<string, string> = {
       "Content-Type": "application/json",
     };
@@ -184,57 +459,365 @@ export class Tieto {
       headers["Authorization"] = `Bearer ${this.config.apiKey}`;
     }
 
-    const response = await fetch(this.config.embeddingUrl, {
+    const json = await this.http()(this.config.embeddingUrl, {
       method: "POST",
       headers,
-      body: JSON.stringify({ input: text }),
+      // a single input is sent as a plain string, which every server takes
+      body: JSON.stringify({
+        input: input.length === 1 ? input[0] : input,
+        ...(this.config.embeddingModel ? { model: this.config.embeddingModel } : {}),
+      }),
+    }, async (response) => {
+      if (!response.ok) {
+        const errText = await response.text();
+        throw new Error(
+          `Embedding request failed: ${response.status} ${errText}`,
+        );
+      }
+      return await response.json();
     });
 
-    if (!response.ok) {
-      const errText = await response.text();
-      throw new Error(
-        `Embedding request failed: ${response.status} ${errText}`,
-      );
-    }
-
-    const json = await response.json();
+    const data: { index?: number; embedding?: unknown }[] = json?.data;
 
     if (
-      !json.data ||
-      !Array.isArray(json.data) ||
-      !json.data[0]?.embedding ||
-      !Array.isArray(json.data[0].embedding)
+      !data ||
+      !Array.isArray(data) ||
+      data.length !== input.length ||
+      !data.every((d) => Array.isArray(d?.embedding))
     ) {
       throw new Error("Embedding output malformed or missing");
     }
 
-    return new Float32Array(json.data[0].embedding);
+    // servers may answer out of order; `index` says which input is which
+    return [...data]
+      .sort((a, b) => (a.index ?? 0) - (b.index ?? 0))
+      .map((d) => new Float32Array(d.embedding as number[]));
   }
 
-  async ingest(path: string): Promise<void> {
+  // {topics}/{topic}/{memory}/{name}, without extension, for the document
+  // at .../{topic}/{name}.txt (however the topics directory is spelled).
+  // The JSONL export and the binary segment files all hang off this.
+  private memoryBaseFor(path: string): string {
+    const topic = basename(dirname(path));
+    const name = basename(path).replace(/\.[^.]+$/, "");
+    return join(this.config.topicsDirectory, topic, this.config.embeddingsDirectory, name);
+  }
+
+  // Identifies a chunk's embedding: same text, same model, same chunking
+  // settings means the stored vector is still good.
+  private async chunkHash(text: string): Promise<string> {
+    const model = this.config.embeddingModel || this.config.embeddingUrl;
+    const key = `${model}\n${this.chunkSettings()}\n${text}`;
+    const digest = await crypto.subtle.digest("SHA-256", new TextEncoder().encode(key));
+    return Array.from(new Uint8Array(digest, 0, 16), (b) => b.toString(16).padStart(2, "0")).join("");
+  }
+
+  private chunkSettings(): string {
+    const { chunkBy, chunkSize, chunkOverlap } = this.config;
+    // lines keep their old key, so topics chunked that way aren't re-embedded
+    return chunkBy === "lines" ? `lines:${chunkSize}` : `${chunkBy}:${chunkSize}:${chunkOverlap}`;
+  }
+
+  // read → frontmatter → chunk → hash; everything before embedding
+  private async prepareDocument(path: string): Promise<PreparedDocument> {
     const raw = await Deno.readTextFile(path);
     const { attrs: meta, body } = extract(raw);
-    const lines = body.split("\n").map((l) => l.trim()).filter(Boolean);
+    const texts = chunkText(body, {
+      by: this.config.chunkBy,
+      size: this.config.chunkSize,
+      overlap: this.config.chunkOverlap,
+    });
+    const hashes = await Promise.all(texts.map((t) => this.chunkHash(t)));
+    return { meta, texts, hashes };
+  }
 
-    const chunks: Chunk[] = [];
+  // hash → vector for every chunk of the document's previous ingest that
+  // still has a full-precision vector and a hash
+  private async previousVectors(base: string): Promise<Map<string, Float32Array>> {
+    const orNull = (e: unknown) => {
+      if (e instanceof Deno.errors.NotFound) return null;
+      throw e;
+    };
+    const seg = await readSegment(base).catch(orNull) ??
+      await readJsonlSegment(`${base}.jsonl`).catch(orNull);
+    if (!seg) return new Map();
+    const reuse = new Map<string, Float32Array>();
+    if (!seg.vectors) return reuse;
+    seg.hashes?.forEach((hash, row) => {
+      if (hash) reuse.set(hash, seg.vectors!.subarray(row * seg.dim, (row + 1) * seg.dim));
+    });
+    return reuse;
+  }
+
+  // Vectors for every chunk of `doc`, reusing ones from the previous ingest
+  // of `base` and sending only new or changed chunks through `send`, in
+  // embeddingBatchSize batches.
+  private async embedDocument(
+    base: string,
+    doc: PreparedDocument,
+    send: (input: string[]) => Promise<Float32Array[]>,
+  ): Promise<Float32Array[]> {
+    const reuse = await this.previousVectors(base);
+    const vectors: (Float32Array | undefined)[] = doc.hashes.map((h) => reuse.get(h));
+    const missing = vectors.flatMap((v, i) => v ? [] : [i]);
+    this.logDebug(
+      `♻️  ${base}: reusing ${vectors.length - missing.length} of ${vectors.length} chunk embeddings`,
+    );
+
+    const size = Math.max(1, this.config.embeddingBatchSize);
+    const batches: Promise<void>[] = [];
+    for (let i = 0; i < missing.length; i += size) {
+      const rows = missing.slice(i, i + size);
+      batches.push(
+        send(rows.map((r) => doc.texts[r])).then((vecs) =>
+          rows.forEach((r, j) => vectors[r] = vecs[j])
+        ),
+      );
+    }
+    await Promise.all(batches);
+    return vectors as Float32Array[];
+  }
+
+  // rows → segment, quantized (and/or kept in full) as configured
+  private buildSegment(
+    vectors: Float32Array[],
+    texts: string[],
+    docs: Record<string, unknown>[],
+    docOf: Uint32Array,
+    hashes?: string[],
+  ): Segment {
+    const dim = vectors[0]?.length ?? 0;
+    const packed = packVectors(vectors, dim);
+    const { quantization, keepFullPrecision } = this.config;
+    const quantized = quantization !== "none";
+    return {
+      dim,
+      count: texts.length,
+      vectors: !quantized || keepFullPrecision ? packed : null,
+      norms: computeNorms(packed, dim, texts.length),
+      quant: quantized ? quantize(quantization, packed, dim, texts.length) : undefined,
+      texts,
+      docs,
+      docOf,
+      hashes,
+    };
+  }
+
+  // write the segment (and JSONL export) for one embedded document
+  private async persistDocument(
+    base: string,
+    { meta, texts, hashes }: PreparedDocument,
+    vectors: Float32Array[],
+  ): Promise<void> {
+    const docOf = new Uint32Array(texts.length);
+    await writeSegment(base, this.buildSegment(vectors, texts, [meta], docOf, hashes));
+    const { quantization, keepFullPrecision } = this.config;
+    const quantized = quantization !== "none";
+
+    // JSONL stays as the export / interchange copy, unless full precision
+    // is deliberately being thrown away (it would carry every float again)
+    if (quantized && !keepFullPrecision) {
+      this.logDebug(`✅ Ingested → ${base}.qvec (${quantization}, no full precision)`);
+      return;
+    }
+    // generated lazily, so only one record is ever stringified at a time;
+    // the frontmatter goes on the first record, the rest refer to it
+    function* chunks(): Generator<JsonlRecord> {
+      for (let i = 0; i < texts.length; i++) {
+        yield {
+          text: texts[i],
+          embedding: Array.from(vectors[i]),
+          doc: 0,
+          meta: i === 0 ? meta : undefined,
+          hash: hashes[i],
+        };
+      }
+    }
+    await writeJsonl(`${base}.jsonl`, chunks());
+    this.logDebug(`✅ Ingested → ${base}.vec (+ .jsonl)`);
+  }
 
-    for (let i = 0; i < lines.length; i += this.config.chunkSize) {
-      const text = lines.slice(i, i + this.config.chunkSize).join("\n");
-      const vec = Array.from(await this.embed(text));
-      chunks.push({ text, embedding: vec, meta });
+  // Chunks whose text (and model / chunk settings) didn't change since the
+  // last ingest of this file keep their stored vectors; only the rest are
+  // embedded.
+  async ingest(path: string): Promise<void> {
+    const base = this.memoryBaseFor(path);
+    const doc = await this.prepareDocument(path);
+    const vectors = await this.embedDocument(base, doc, (input) => this.requestEmbeddings(input));
+    await this.persistDocument(base, doc, vectors);
+  }
+
+  // Ingest every document (.txt / .md) directly in {topics}/{topic}.
+  //
+  // Files are read and chunked a few at a time while earlier files' batches
+  // are still out at the embedding server, with at most ingestConcurrency
+  // embedding requests in flight across the whole topic. Each document is
+  // written as soon as its last batch comes back. A failing document
+  // doesn't stop the others; failures are reported together at the end.
+  // Resolves to the number of documents ingested.
+  async ingestTopic(topic: string): Promise<number> {
+    const topicDir = join(this.config.topicsDirectory, topic);
+    const paths: string[] = [];
+    for await (const entry of Deno.readDir(topicDir)) {
+      if (entry.isFile && /\.(txt|md)$/.test(entry.name)) {
+        paths.push(join(topicDir, entry.name));
+      }
     }
 
-    const [, topic, nameTxt] = path.split("/");
-    const out = `${this.config.topicsDirectory}/${topic}/${this.config.embeddingsDirectory}/${nameTxt.replace(/\.txt$/, ".jsonl")}`;
-    await Deno.writeTextFile(
-      out,
-      chunks.map((c) => JSON.stringify(c)).join("\n"),
+    // a brand new topic has no memory directory yet
+    await Deno.mkdir(join(topicDir, this.config.embeddingsDirectory), { recursive: true });
+
+    const concurrency = this.config.ingestConcurrency;
+    const embedSlots = createLimiter(concurrency);
+    // read ahead a little, but don't hold the whole topic in memory
+    const fileSlots = createLimiter(concurrency * 2);
+
+    const results = await Promise.allSettled(paths.map((path) =>
+      fileSlots(async () => {
+        const base = join(
+          topicDir,
+          this.config.embeddingsDirectory,
+          basename(path).replace(/\.[^.]+$/, ""),
+        );
+        const doc = await this.prepareDocument(path);
+        const vectors = await this.embedDocument(base, doc, (input) =>
+          embedSlots(() => this.requestEmbeddings(input))
+        );
+        await this.persistDocument(base, doc, vectors);
+      })
+    ));
+
+    const failed = results.flatMap((r, i) =>
+      r.status === "rejected" ? [`${paths[i]}: ${r.reason}`] : []
     );
-    this.logDebug(`✅ Ingested → ${out}`);
+    // whatever did get ingested counts towards the topic's statistics
+    if (failed.length < paths.length) await this.calibrate(topic);
+    if (failed.length) {
+      throw new Error(`Failed to ingest ${failed.length} of ${paths.length} documents:\n${failed.join("\n")}`);
+    }
+    this.logDebug(`✅ Ingested ${paths.length} documents in topic '${topic}'`);
+    return paths.length;
+  }
+
+  // {topics}/{topic}/{memory}/remembered: the memory log is .log, its
+  // compacted rows the binary segment
+  private rememberedBase(topic: string): string {
+    return join(this.config.topicsDirectory, topic, this.config.embeddingsDirectory, "remembered");
+  }
+
+  private memoryLog(topic: string): MemoryLog {
+    let log = this.memoryLogs.get(topic);
+    if (!log) {
+      log = new MemoryLog(`${this.rememberedBase(topic)}.log`, this.config.memoryFlushMs);
+      this.memoryLogs.set(topic, log);
+    }
+    return log;
+  }
+
+  // Store one text (a chat turn, a fact) in a topic right away, no file
+  // needed. It's embedded and appended to the topic's memory log, and the
+  // next search sees it. Resolves once the record is synced to disk;
+  // calls arriving close together share one sync.
+  async remember(
+    topic: string,
+    text: string,
+    meta: Record<string, unknown> = {},
+  ): Promise<void> {
+    const vec = await this.embedOne(text);
+    const log = this.memoryLog(topic);
+    await log.append({ text, embedding: Array.from(vec), meta });
+
+    const limit = this.config.compactMemoryAbove;
+    if (limit > 0 && !this.compacting.has(topic) && await log.bytes() > limit) {
+      // the log stays valid (and searchable) until compaction is done
+      const run = this.compactMemory(topic)
+        .catch((e) => console.error(`Memory compaction failed for '${topic}':`, e))
+        .finally(() => this.compacting.delete(topic));
+      this.compacting.set(topic, run);
+    }
+  }
+
+  // Fold a topic's memory log into its `remembered` segment and empty the
+  // log. remember() does this by itself past compactMemoryAbove; appends
+  // made while it runs wait and land in the fresh log.
+  async compactMemory(topic: string): Promise<void> {
+    const base = this.rememberedBase(topic);
+    const logPath = `${base}.log`;
+    const log = this.memoryLog(topic);
+    await log.exclusive(async () => {
+      const vectors: Float32Array[] = [];
+      const texts: string[] = [];
+      const table = new DocTable();
+      const docOf: number[] = [];
+      const orNull = (e: unknown) => {
+        if (e instanceof Deno.errors.NotFound) return null;
+        throw e;
+      };
+
+      const old = await readSegment(base).catch(orNull);
+      if (old) texts.push(...await readTexts(old, old.docOf.map((_, r) => r)));
+      for (let r = 0; r < (old?.count ?? 0); r++) {
+        const seg = old!;
+        vectors.push(
+          seg.vectors
+            ? seg.vectors.slice(r * seg.dim, (r + 1) * seg.dim)
+            : dequantizeRow(seg.quant!, seg.norms, r, new Float32Array(seg.dim)),
+        );
+        docOf.push(table.add(metaOf(seg, r)));
+      }
+
+      // only what the segment doesn't hold yet
+      const tail = new LogTail();
+      const fresh = await tail.refresh(logPath, old?.log).catch(orNull);
+      const added = fresh?.count ?? 0;
+      for (let r = 0; r < added; r++) {
+        const seg = fresh!;
+        vectors.push(seg.vectors!.slice(r * seg.dim, (r + 1) * seg.dim));
+        texts.push(seg.texts![r]);
+        docOf.push(table.add(metaOf(seg, r)));
+      }
+
+      if (added) {
+        // the sidecar says how much of the log the segment took over, and
+        // it's renamed into place last: once it's there, readers skip
+        // those records, so a crash before the log is restarted below
+        // can't count them twice
+        const seg = this.buildSegment(vectors, texts, table.docs, Uint32Array.from(docOf));
+        seg.log = tail.mark;
+        await writeSegment(base, seg);
+      } else if (!fresh || old?.log?.generation !== tail.mark.generation) {
+        // nothing folded in now or by a run that crashed before restarting
+        return;
+      }
+      await log.restart();
+      // the resident copy of the log is stale now
+      this.resident.get(topic)?.delete(logPath);
+      this.logDebug(`🗜️  Compacted ${added} remembered records into ${base}`);
+    });
+  }
+
+  // One --filter expression. Terms separated by `|` are OR-ed, and a
+  // leading `!` negates a term:  status=current|status=draft  !tag=internal
+  private parseFilterExpr(expr: string): FilterExpr | null {
+    const terms: FilterExpr[] = [];
+    for (const raw of expr.split("|")) {
+      const term = raw.trim();
+      const negate = term.startsWith("!");
+      const match = term.slice(negate ? 1 : 0).trim()
+        .match(/^([^\s><=!|]+)\s*(>=|<=|=|>|<|in)\s*(.+)$/);
+      if (!match) return null;
+      const [, key, op, valRaw] = match as [string, string, Op, string];
+      const value: string | string[] = op === "in"
+        ? valRaw.split(",").map((s) => s.trim())
+        : valRaw.trim();
+      terms.push(negate ? { not: { key, op, value } } : { key, op, value });
+    }
+    return terms.length === 1 ? terms[0] : { any: terms };
   }
 
-  parseFilters(args: string[]): Filter[] {
-    const filters: Filter[] = [];
+  // Separate --filter flags are AND-ed together
+  parseFilters(args: string[]): FilterExpr[] {
+    const filters: FilterExpr[] = [];
     for (let i = 0; i < args.length; i++) {
       let expr: string | undefined;
       // styles:  --filter key=val   OR  --filter=key=val
@@ -246,104 +829,671 @@ export class Tieto {
       }
       if (!expr) continue;
 
-      const match = expr.match(/^([^\s><=]+)\s*(>=|<=|=|>|<|in)\s*(.+)$/);
-      if (!match) {
+      const parsed = this.parseFilterExpr(expr);
+      if (!parsed) {
         this.logDebug(`⚠️  Ignoring bad filter expression: '${expr}'`);
         continue;
       }
-      const [, key, op, valRaw] = match as [string, string, Op, string];
-      const value: string | string[] = op === "in"
-        ? valRaw.split(",").map((s) => s.trim())
-        : valRaw.trim();
-      filters.push({ key, op, value });
+      filters.push(parsed);
     }
     this.logDebug("Parsed_filters:", filters);
     return filters;
   }
 
-  private satisfies(meta: Record<string, unknown>, f: Filter): boolean {
-    const actualRaw = meta?.[f.key];
-    if (actualRaw === undefined || actualRaw === null) return false;
+  // mtime + size of the files that make up one segment. If this string
+  // hasn't changed, neither has the segment. `optional` files may be
+  // missing (e.g. the .text file of an older segment).
+  private async fingerprint(paths: string[], optional: string[] = []): Promise<string> {
+    const parts: string[] = [];
+    for (const p of paths) {
+      const info = await Deno.stat(p);
+      parts.push(`${info.mtime?.getTime() ?? 0}:${info.size}`);
+    }
+    for (const p of optional) {
+      try {
+        const info = await Deno.stat(p);
+        parts.push(`${info.mtime?.getTime() ?? 0}:${info.size}`);
+      } catch (e) {
+        if (!(e instanceof Deno.errors.NotFound)) throw e;
+        parts.push("-");
+      }
+    }
+    return parts.join("|");
+  }
+
+  // total size of some files, in bytes
+  private async fileBytes(paths: string[]): Promise<number> {
+    let bytes = 0;
+    for (const p of paths) bytes += (await Deno.stat(p)).size;
+    return bytes;
+  }
+
+  // Every segment under {topic}/{memory}. Binary segments win; a .jsonl is
+  // only parsed when there's no .vec of the same name next to it.
+  //
+  // Segments stay resident on the instance, keyed by file path. Each call
+  // re-walks the directory and stats the files, but only segments whose
+  // fingerprint changed are read again, and deleted ones are dropped.
+  private async loadSegments(topic: string): Promise<TopicView> {
+    // concurrent searches on a cold topic share one load
+    const pending = this.loading.get(topic);
+    if (pending) return pending;
+
+    const load = this.refreshTopic(topic).finally(() =>
+      this.loading.delete(topic)
+    );
+    this.loading.set(topic, load);
+    return load;
+  }
+
+  private async refreshTopic(topic: string): Promise<TopicView> {
+    const memDir = join(this.config.topicsDirectory,
+      topic, this.config.embeddingsDirectory);
+    // base → row files (.vec and/or .qvec) present for it
+    const binary = new Map<string, string[]>();
+    const jsonl = new Set<string>();
+
+    const logs: string[] = [];
+
+    for await (
+      const file of walk(memDir, { exts: [".vec", ".qvec", ".jsonl", ".log"], includeDirs: false })
+    ) {
+      if (file.path.endsWith(".log")) {
+        logs.push(file.path);
+        continue;
+      }
+      if (file.path.endsWith(".jsonl")) {
+        jsonl.add(file.path.slice(0, -".jsonl".length));
+        continue;
+      }
+      const base = file.path.replace(/\.q?vec$/, "");
+      binary.set(base, [...binary.get(base) ?? [], file.path]);
+    }
+
+    const previous = this.resident.get(topic) ?? new Map<string, ResidentSegment>();
+    const current = new Map<string, ResidentSegment>();
+
+    // base, files read on load, files only fingerprinted, loader
+    const sources: [string, string[], string[], () => Promise<Segment>][] = [];
+    for (const [base, rowFiles] of binary) {
+      // the .text file is read later, for the winners, but a resident copy
+      // with stale offsets must not outlive it
+      sources.push([
+        base,
+        [...rowFiles.sort(), sidecarPath(base)],
+        [textPath(base)],
+        () => readSegment(base),
+      ]);
+    }
+    // JSONL past streamJsonlAbove bytes is never made resident; search
+    // streams through it on every query instead
+    const streamed: string[] = [];
+    let bytesRead = 0;
+    for (const base of jsonl) {
+      if (binary.has(base)) continue;
+      const path = `${base}.jsonl`;
+      const { size } = await Deno.stat(path);
+      if (size > this.config.streamJsonlAbove) {
+        streamed.push(path);
+        bytesRead += size;
+        continue;
+      }
+      sources.push([base, [path], [], () => readJsonlSegment(path)]);
+    }
+
+    for (const [base, paths, extra, read] of sources) {
+      let fingerprint: string;
+      try {
+        fingerprint = await this.fingerprint(paths, extra);
+      } catch (e) {
+        // a first ingest whose sidecar isn't written yet, or a segment
+        // removed since the walk: not a segment (yet)
+        if (e instanceof Deno.errors.NotFound) continue;
+        throw e;
+      }
+      const cached = previous.get(base);
+      if (cached && cached.fingerprint === fingerprint) {
+        current.set(base, cached);
+        continue;
+      }
+      this.logDebug(`📥 Loading segment ${base}`);
+      const segment = await read();
+      bytesRead += await this.fileBytes(paths);
+      this.prepareRows(segment);
+      // index the frontmatter now, while we're paying for the load anyway
+      this.metaIndexFor(segment);
+      current.set(base, {
+        name: base.slice(memDir.length + 1),
+        fingerprint,
+        segment,
+      });
+    }
+
+    // memory logs (see remember()) are never reloaded, only read from where
+    // the last refresh left off
+    for (const path of logs) {
+      const cached = previous.get(path);
+      const tail = cached?.tail ?? new LogTail();
+      const before = tail.bytes;
+      // skipping what has been compacted into the segment next to it
+      const compacted = current.get(path.slice(0, -".log".length))?.segment.log;
+      const segment = await tail.refresh(path, compacted);
+      bytesRead += Math.max(0, tail.bytes - before);
+      if (!segment.count) continue;
+      if (segment !== cached?.segment) {
+        this.prepareRows(segment);
+        this.metaIndexFor(segment);
+      }
+      current.set(path, {
+        // keeps its extension, so it never collides with a segment's name;
+        // buildIndex() leaves logs out, since they're replaced and refilled
+        // in place and a row count says nothing about which rows they hold
+        name: path.slice(memDir.length + 1),
+        fingerprint: `${segment.count}`,
+        segment,
+        tail,
+      });
+    }
+
+    this.resident.set(topic, current);
+    return { segments: [...current.values()], streamed, bytesRead };
+  }
+
+  // Preload a topic, e.g. when a server starts, so the first query doesn't
+  // pay for the disk read.
+  async warm(topic: string): Promise<void> {
+    await this.loadSegments(topic);
+  }
+
+  // Drop a topic's resident segments (or every topic's, with no argument).
+  // The next search reads everything from disk again.
+  invalidate(topic?: string): void {
+    if (topic === undefined) this.resident.clear();
+    else this.resident.delete(topic);
+  }
+
+  // Stop the scan workers, if any were started. The instance still works
+  // afterwards; a later big scan starts a fresh pool.
+  close(): void {
+    this.pool?.close();
+    this.pool = undefined;
+  }
+
+  // Rows laid out for how this config scans them: the Matryoshka prefix
+  // copy built (or dropped) to match prefixDims, and everything in shared
+  // memory when there are workers. Cheap when nothing changed.
+  private prepareRows(seg: Segment): void {
+    const keep = this.config.prefixDims;
+    if (keep <= 0 || keep >= seg.dim || !seg.vectors || seg.quant) {
+      seg.prefix = undefined;
+    } else if (seg.prefix?.dim !== keep) {
+      seg.prefix = truncateRows(seg.vectors, seg.dim, seg.count, keep);
+    }
+    if (this.config.workers > 0) shareSegment(seg);
+  }
+
+  private metaIndexFor(seg: Segment): MetaIndex {
+    let index = this.metaIndexes.get(seg);
+    if (!index) {
+      index = new MetaIndex(seg.docs, seg.docOf);
+      this.metaIndexes.set(seg, index);
+    }
+    return index;
+  }
+
+  // Rows of a segment (all of them, or just `within`) whose metadata passes
+  // every filter. Answered from the segment's metadata index, so rows that
+  // don't match are never visited at all.
+  private filterRows(seg: Segment, filter: Compiled | null, within?: Uint32Array): Uint32Array {
+    if (!filter) {
+      return within ?? Uint32Array.from({ length: seg.count }, (_, i) => i);
+    }
+    const selected = this.metaIndexFor(seg).select(filter);
+    const rows = within ? intersectRows(selected, within) : selected;
+    const considered = within ? within.length : seg.count;
+    if (rows.length < considered) {
+      this.logDebug(`⛔ Excluded by filter: ${considered - rows.length} of ${considered} chunks`);
+    }
+    return rows;
+  }
 
-    // convert arrays, objects → string consistently for comparison
-    const actualStr = Array.isArray(actualRaw)
-      ? actualRaw.join(",")
-      : actualRaw.toString();
+  private ivfPath(topic: string): string {
+    return join(this.config.topicsDirectory, topic, "ivf.bin");
+  }
 
-    if (f.op === "=") return actualStr === f.value;
-    if (f.op === "in") {
-      const list = Array.isArray(f.value)
-        ? f.value
-        : (f.value as string).split(",");
-      return list.includes(actualStr);
+  // The topic's IVF index, if it has one; kept resident like segments
+  private async loadIvf(topic: string): Promise<IvfIndex | null> {
+    const path = this.ivfPath(topic);
+    let fingerprint: string;
+    try {
+      fingerprint = await this.fingerprint([path]);
+    } catch (e) {
+      if (e instanceof Deno.errors.NotFound) {
+        this.ivf.delete(topic);
+        return null;
+      }
+      throw e;
     }
+    const cached = this.ivf.get(topic);
+    if (cached && cached.fingerprint === fingerprint) return cached.index;
+    const index = await readIvf(path);
+    this.ivf.set(topic, { fingerprint, index });
+    return index;
+  }
 
-    // numeric or date compare
-    const left = Number(actualStr) || Date.parse(actualStr);
-    const right = Number(f.value as string) || Date.parse(f.value as string);
-    if (isNaN(left) || isNaN(right)) return false;
+  // segment name → sorted rows found in the lists nearest the query
+  private probeIvf(index: IvfIndex, q: Float32Array): Map<string, Uint32Array> {
+    if (q.length !== index.dim) {
+      throw new Error("Vectors must have the same dimension.");
+    }
+    const lists = probeLists(index, q, this.config.nprobe, this.scorerFor(index.dim));
+    const bySegment = new Map<number, number[]>();
+    for (const list of lists) {
+      for (let p = index.offsets[list]; p < index.offsets[list + 1]; p++) {
+        const s = index.postings[p * 2];
+        let rows = bySegment.get(s);
+        if (!rows) bySegment.set(s, rows = []);
+        rows.push(index.postings[p * 2 + 1]);
+      }
+    }
+    const out = new Map<string, Uint32Array>();
+    for (const [s, rows] of bySegment) {
+      out.set(index.segments[s].name, Uint32Array.from(rows).sort());
+    }
+    return out;
+  }
 
-    switch (f.op) {
-      case ">=":
-        return left >= right;
-      case "<=":
-        return left <= right;
-      case ">":
-        return left > right;
-      case "<":
-        return left < right;
+  // Build (or rebuild) the topic's IVF index from the segments in its
+  // memory directory. search() picks it up automatically. Memory logs and
+  // streamed JSONL aren't indexed; search scans them in full.
+  async buildIndex(topic: string): Promise<void> {
+    const view = await this.loadSegments(topic);
+    const { streamed } = view;
+    if (streamed.length) {
+      this.logDebug(`⚠️  Not indexing ${streamed.length} streamed JSONL file(s); they stay full scans`);
     }
+    const resident = view.segments.filter((r) => !r.tail);
+    const rows = resident.reduce((n, r) => n + r.segment.count, 0);
+    if (!rows) throw new Error(`Nothing to index in topic '${topic}'`);
+    const dim = resident.find((r) => r.segment.count)!.segment.dim;
+    const index = buildIvf(resident, this.scorerFor(dim), { nlist: this.config.ivfLists });
+    await writeIvf(this.ivfPath(topic), index);
+    this.logDebug(`✅ Indexed ${rows} chunks into ${index.nlist} lists → ${this.ivfPath(topic)}`);
+    await this.calibrate(topic);
+  }
+
+  private manifestPath(topic: string): string {
+    return join(this.config.topicsDirectory, topic, "manifest.json");
+  }
 
-    // default
-    return false;
+  // Sample chunk pairs of the topic and record their score distribution in
+  // its manifest, for thresholdPercentile. Runs after ingestTopic() and
+  // buildIndex(); run it again after ingesting files one at a time.
+  async calibrate(topic: string): Promise<void> {
+    const { segments: resident } = await this.loadSegments(topic);
+    const segments = resident.map((r) => r.segment).filter((seg) => seg.count);
+    const stats = segments.length ? sampleStats(segments, this.scorerFor(segments[0].dim)) : null;
+    if (!stats) {
+      this.logDebug(`⚠️  Too few chunks in topic '${topic}' to calibrate thresholds`);
+      return;
+    }
+    await writeStats(this.manifestPath(topic), stats);
+    const { minSimilarity, maxDistance } = thresholdsAt(stats, 99);
+    this.logDebug(
+      `📏 Sampled ${stats.pairs} chunk pairs in '${topic}': 99th percentile similarity ` +
+        `${minSimilarity.toFixed(3)}, distance ${maxDistance.toFixed(3)}`,
+    );
+  }
+
+  // Similarity floor and distance ceiling for results from `topic`: from its
+  // manifest with thresholdPercentile on, else the configured ones. The
+  // manifest is kept resident like the IVF index.
+  private async thresholdsFor(topic: string): Promise<Thresholds> {
+    const fixed = {
+      minSimilarity: this.config.minSimilarityThreshold,
+      maxDistance: this.config.maxDistance,
+    };
+    const percentile = this.config.thresholdPercentile;
+    if (percentile <= 0) return fixed;
+    const path = this.manifestPath(topic);
+    let fingerprint: string;
+    try {
+      fingerprint = await this.fingerprint([path]);
+    } catch (e) {
+      if (e instanceof Deno.errors.NotFound) {
+        this.stats.delete(topic);
+        return fixed;
+      }
+      throw e;
+    }
+    let cached = this.stats.get(topic);
+    if (!cached || cached.fingerprint !== fingerprint) {
+      cached = { fingerprint, stats: await readStats(path) };
+      this.stats.set(topic, cached);
+    }
+    return thresholdsAt(cached.stats, percentile);
+  }
+
+  // WASM SIMD kernel when enabled and usable for this dimension, else the
+  // plain JS one. The module is compiled once, on first use.
+  private scorerFor(dim: number): RowScorer {
+    if (!this.config.simd || dim % 4 !== 0) return scoreRows;
+    if (this.simdScorer === undefined) {
+      this.simdScorer = createSimdScorer();
+      if (!this.simdScorer) this.logDebug("⚠️  WASM SIMD unavailable, using JS scoring");
+    }
+    return this.simdScorer ?? scoreRows;
+  }
+
+  // the same, for scanning a block of rows against many questions
+  private blockScorerFor(dim: number): BlockScorer {
+    if (!this.config.simd || dim % 4 !== 0) return dotBlock;
+    if (this.simdBlockScorer === undefined) this.simdBlockScorer = createSimdBlockScorer();
+    return this.simdBlockScorer ?? dotBlock;
+  }
+
+  // Filter and score a JSONL file record by record as it streams in, so
+  // memory stays bounded by the heap rather than the file size. Records
+  // that get into `top` are kept in `hits` until they fall out again. The
+  // filter runs once per document of the file (per record for files
+  // without doc ids). Resolves to the number of records read.
+  private async scanJsonl(
+    path: string,
+    filter: Compiled | null,
+    qVecs: Float32Array[],
+    qNorms: ArrayLike<number>,
+    s: number,
+    tops: TopK[],
+    hits: Map<string, Omit<ScoredChunk, "topic" | "score" | "distance">>,
+  ): Promise<number> {
+    const dim = qVecs[0].length;
+    const row = new Float32Array(dim);
+    const pair = new Float64Array(2);
+    // record → the (question, score) pairs it got into a heap with
+    const entered = new Map<string, [number, number][]>();
+    const limit = Math.max(64, tops.reduce((n, t) => n + t.k, 0) * 4);
+    // doc id → its frontmatter, and whether it passed the filter
+    const docs = new Map<number, [Record<string, unknown>, boolean]>();
+    let r = 0;
+    for await (const c of streamJsonl(path)) {
+      const at = r++;
+      let doc = c.doc === undefined ? undefined : docs.get(c.doc);
+      if (!doc) {
+        const meta = c.meta ?? {};
+        doc = [meta, !filter || filter.test(meta)];
+        if (c.doc !== undefined) docs.set(c.doc, doc);
+        if (!doc[1]) this.logDebug("⛔ Excluded by filter:", meta);
+      }
+      const [meta, passed] = doc;
+      if (!passed) continue;
+      if (c.embedding.length !== dim) {
+        throw new Error("Vectors must have the same dimension.");
+      }
+      row.set(c.embedding);
+      const norm = rowNorm(row, 0, dim);
+      let kept: [number, number][] | undefined;
+      for (let j = 0; j < tops.length; j++) {
+        dotAndSqDist(row, 0, qVecs[j], dim, pair);
+        const score = cosineFromDot(pair[0], norm, qNorms[j]);
+        if (score <= tops[j].floor) continue;
+        tops[j].push(score, s, at, pair[1]);
+        (kept ??= []).push([j, score]);
+      }
+      if (!kept) continue;
+
+      const key = `${s}:${at}`;
+      hits.set(key, { text: c.text, embedding: row.slice(), meta });
+      entered.set(key, kept);
+      // drop records every heap has since pushed out
+      if (entered.size > limit) {
+        for (const [k, scores] of entered) {
+          if (scores.every(([j, sc]) => sc < tops[j].floor)) {
+            entered.delete(k);
+            hits.delete(k);
+          }
+        }
+      }
+    }
+    return r;
   }
 
   async search(
     topic: string,
     question: string,
-    filters: Filter[] = [],
+    filters: FilterExpr[] = [],
   ): Promise<ScoredChunk[]> {
-    const memDir = join(this.config.topicsDirectory, 
-      topic, this.config.embeddingsDirectory);
-    const chunks: Chunk[] = [];
+    return this.searchMany([topic], question, filters);
+  }
 
-    for await (
-      const file of walk(memDir, { exts: [".jsonl"], includeDirs: false })
-    ) {
-      const lines = (await Deno.readTextFile(file.path)).trim().split("\n");
-      for (const line of lines) {
-        const c = JSON.parse(line);
-        if (filters.every((f) => this.satisfies(c.meta ?? {}, f))) {
-          chunks.push(c);
-        } else {
-          this.logDebug("⛔ Excluded by filter:", c.meta);
-        }
+  // Search several topics as one: the question is embedded once, the
+  // topics are loaded concurrently, and every topic's chunks compete for the
+  // same top maxResults under the usual thresholds. Each result says which
+  // topic it came from. `onMetrics` gets this search's metrics, on top of
+  // the configured hook.
+  async searchMany(
+    topics: string[],
+    question: string,
+    filters: FilterExpr[] = [],
+    onMetrics?: MetricsHook,
+  ): Promise<ScoredChunk[]> {
+    const elapsed = stopwatch();
+    const [chunks, metrics] = await this.untorn(
+      topics,
+      (m) => this.searchTimed(topics, question, filters, m),
+    );
+    this.emitMetrics(metrics, elapsed(), onMetrics);
+    return chunks;
+  }
+
+  // Run a search pass with fresh metrics, and run it again when winners()
+  // finds a segment's texts re-ingested under it (it drops the topic, so
+  // the next pass loads and ranks what's on disk now). Bounded like
+  // readSegment()'s retries: a re-ingest is over in a few renames.
+  private async untorn<T>(
+    topics: string[],
+    pass: (m: QueryMetrics) => Promise<T>,
+  ): Promise<[T, QueryMetrics]> {
+    for (let attempt = 1;; attempt++) {
+      const m = newMetrics(topics);
+      try {
+        return [await pass(m), m];
+      } catch (e) {
+        if (!(e instanceof TornRead) || attempt >= READ_ATTEMPTS) throw e;
+        this.logDebug(`🔁 ${e.message}, searching again`);
+        await new Promise((resolve) => setTimeout(resolve, READ_RETRY_MS));
       }
     }
+  }
 
-    if (!chunks.length) {
+  // Hand a finished query's metrics to the hook(s) / debug output; a hook
+  // that throws is logged, never fails the query
+  private emitMetrics(metrics: QueryMetrics, total: number, extra?: MetricsHook): void {
+    metrics.timings.total = total;
+    this.logDebug(`⏱️  ${formatMetrics(metrics)}`);
+    for (const hook of [this.config.onMetrics, extra]) {
+      if (!hook) continue;
+      try {
+        hook(metrics);
+      } catch (e) {
+        console.error("onMetrics hook failed:", e);
+      }
+    }
+  }
+
+  // searchMany(), recording phase timings and counts into `m`
+  private async searchTimed(
+    topics: string[],
+    question: string,
+    filters: FilterExpr[],
+    m: QueryMetrics,
+  ): Promise<ScoredChunk[]> {
+    const lap = stopwatch();
+    const views = await Promise.all([...new Set(topics)].map(async (topic) => {
+      const [view, ivf, limits] = await Promise.all([
+        this.loadSegments(topic),
+        this.loadIvf(topic),
+        this.thresholdsFor(topic),
+      ]);
+      return { topic, ...view, ivf, limits };
+    }));
+    const limits = new Map(views.map((v) => [v.topic, v.limits]));
+    for (const view of views) m.bytesRead += view.bytesRead;
+    m.timings.load = lap();
+    // compiled once; every segment and streamed record reuses it
+    const filter = filters.length ? compileFilters(filters) : null;
+    const candidates: { topic: string; seg: Segment; rows: Uint32Array }[] = [];
+    const streamed: { topic: string; path: string }[] = [];
+    let total = 0;
+
+    // With an IVF index the question is embedded first, so only rows in
+    // the probed lists are filtered and scored. Segments the index doesn't
+    // cover (new or re-ingested since it was built) are scanned in full.
+    // Streamed files can only be filtered as they're read, so there's no
+    // knowing up front whether anything matches; they need it too.
+    let qVec: Float32Array | undefined;
+    const embed = async () => {
+      lap();
+      const [vec, cached] = await this.embedQuestion(question);
+      m.timings.embed = lap();
+      m.embeddingCached = cached;
+      return vec;
+    };
+    if (views.some((v) => v.ivf || v.streamed.length)) qVec = await embed();
+
+    for (const { topic, segments: resident, streamed: paths, ivf } of views) {
+      const probed = ivf ? this.probeIvf(ivf, qVec!) : undefined;
+      const coverage = new Map(ivf?.segments.map((s) => [s.name, s]));
+      for (const { name, fingerprint, segment: seg, tail } of resident) {
+        const built = coverage.get(name);
+        // memory logs are never covered, even by an index from before
+        // buildIndex() left them out
+        const covered = probed && !tail && built?.fingerprint === fingerprint &&
+          built.count === seg.count;
+        const rows = this.filterRows(
+          seg,
+          filter,
+          covered ? probed?.get(name) ?? new Uint32Array(0) : undefined,
+        );
+        if (rows.length) candidates.push({ topic, seg, rows });
+        total += rows.length;
+        m.counts.segments++;
+        m.counts.chunks += seg.count;
+      }
+      for (const path of paths) streamed.push({ topic, path });
+    }
+    m.counts.candidates = total;
+    m.timings.filter = lap();
+
+    if (!total && !streamed.length) {
       this.logDebug("⚠️  No data matched filters", filters);
       return [];
     }
 
-    const qVec = Array.from(await this.embed(question));
-    const scored = chunks.map((c) => (
-      { 
-        ...c, 
-        score: this.cosineSimilarity(c.embedding, qVec), 
-        distance: this.euclideanDistance(c.embedding, qVec) 
+    qVec ??= await embed();
+    const qNorm = rowNorm(qVec, 0, qVec.length);
+    const top = new TopK(this.config.maxResults);
+
+    for (const { seg } of candidates) {
+      if (seg.dim !== qVec.length) {
+        throw new Error("Vectors must have the same dimension.");
       }
-    ))
-      .sort((a, b) => b.score - a.score)
-      .slice(0, this.config.maxResults);
+      // prefixDims or workers may have changed since it was loaded
+      this.prepareRows(seg);
+    }
+
+    // Big scans are sharded across the worker pool. Streamed files are
+    // still read here, while the workers are busy, and their top hits are
+    // merged in afterwards.
+    const scanOptions = (seg: Segment) => ({
+      scorer: this.scorerFor(seg.dim),
+      maxResults: this.config.maxResults,
+      rescoreFactor: this.config.rescoreFactor,
+      prefixScorer: seg.prefix ? this.scorerFor(seg.prefix.dim) : undefined,
+    });
+    let parallel: Promise<ScanResult> | undefined;
+    if (this.config.workers > 0 && total >= this.config.workerMinRows) {
+      m.parallel = true;
+      this.pool ??= new ScanPool(this.config.workers);
+      this.logDebug(`🧵 Scanning ${total} chunks on ${this.pool.size} workers`);
+      parallel = this.pool.scan(
+        candidates.map(({ seg, rows }, s) => ({
+          s,
+          // rows and norms only; texts and docs stay on this thread
+          seg: {
+            dim: seg.dim,
+            count: seg.count,
+            vectors: seg.vectors,
+            norms: seg.norms,
+            quant: seg.quant,
+            prefix: seg.prefix,
+          },
+          rows,
+          shortlist: shortlisted(seg, rows.length, scanOptions(seg)),
+        })),
+        qVec,
+        qNorm,
+        {
+          maxResults: this.config.maxResults,
+          rescoreFactor: this.config.rescoreFactor,
+          simd: this.config.simd,
+          prefixDims: this.config.prefixDims,
+        },
+      );
+    } else {
+      const most = candidates.reduce((m, c) => Math.max(m, c.rows.length), 0);
+      const dots = new Float32Array(most);
+      const sqDists = new Float32Array(most);
+      for (let s = 0; s < candidates.length; s++) {
+        const { seg, rows } = candidates[s];
+        scanSegment(seg, rows, qVec, qNorm, s, top, scanOptions(seg), dots, sqDists);
+      }
+      m.timings.score = lap();
+    }
+
+    // records of streamed files that made it into the heap at some point,
+    // keyed by candidate index + row; trimmed to the heap as it fills
+    const hits = new Map<string, Omit<ScoredChunk, "topic" | "score" | "distance">>();
+    for (let f = 0; f < streamed.length; f++) {
+      m.counts.streamed += await this.scanJsonl(
+        streamed[f].path, filter, [qVec], [qNorm], candidates.length + f, [top], hits,
+      );
+    }
+    if (streamed.length) m.timings.stream = lap();
+    if (parallel) {
+      const { hits: found, shortlists } = await parallel;
+      for (const h of found) {
+        if (h.score > top.floor) top.push(h.score, h.seg, h.row, h.extra);
+      }
+      // the shard shortlists of a segment, cut down to what a serial scan
+      // would have kept, are few enough rows to rescore right here
+      const keep = this.config.maxResults * this.config.rescoreFactor;
+      const lists = new Map<number, TopK>();
+      for (const h of shortlists) {
+        let list = lists.get(h.seg);
+        if (!list) lists.set(h.seg, list = new TopK(keep));
+        if (h.score > list.floor) list.push(h.score, h.seg, h.row);
+      }
+      for (const [s, list] of lists) {
+        const rows = Uint32Array.from(list.sorted(), (h) => h.row).sort();
+        const dots = new Float32Array(rows.length);
+        const sqDists = new Float32Array(rows.length);
+        const { seg } = candidates[s];
+        scanSegment(seg, rows, qVec, qNorm, s, top, scanOptions(seg), dots, sqDists);
+      }
+      // the workers ran while the streamed files were read
+      m.timings.score = lap() + m.timings.stream;
+    }
+
+    const [scored] = await this.winners([top], candidates, streamed, hits, m);
 
     // Not exactly needed once you get the class dialed into the corpus you're using, 
     // but if that corpus changes, you'll miss having this. I suggest leaving it here :)
-    this.logDebug(
-      "Query: minimum score for inclusion is " +
-      this.config.minSimilarityThreshold + 
-      " with a distance of " + this.config.maxDistance
-    );
+    for (const [topic, { minSimilarity, maxDistance }] of limits) {
+      this.logDebug(
+        `Query: minimum score for inclusion in '${topic}' is ` +
+        minSimilarity + " with a distance of " + maxDistance
+      );
+    }
     this.logDebug("Query: winning cosine similarity score was ", scored[0]?.score);
     this.logDebug("Query: selected winner Euclidean distance was ", scored[0]?.distance);
     this.logDebug("Info: Selected chunks follow below, and are not intentionally sorted by distance.");
@@ -362,27 +1512,227 @@ export class Tieto {
       console.log("");
     }
 
-    return scored.filter((chunk) =>
-      chunk.score >= this.config.minSimilarityThreshold &&
-      chunk.distance <= this.config.maxDistance
+    const passed = scored.filter((chunk) => this.passes(chunk, limits));
+    m.counts.returned = passed.length;
+    m.timings.sort = lap();
+    return passed;
+  }
+
+  // Only the winners become chunk objects (one list per heap); embeddings
+  // are copied out so callers don't pin the whole segment, and texts are
+  // read from disk for just these rows, once per segment. Heap entries past
+  // the resident candidates are streamed records, kept in `hits`.
+  private async winners(
+    tops: TopK[],
+    candidates: { topic: string; seg: Segment }[],
+    streamed: { topic: string }[],
+    hits: Map<string, Omit<ScoredChunk, "topic" | "score" | "distance">>,
+    m: QueryMetrics,
+  ): Promise<ScoredChunk[][]> {
+    const ranked = tops.map((top) => top.sorted());
+    // candidate index → row → text
+    const wanted = new Map<number, Map<number, string>>();
+    for (const { seg: s, row } of ranked.flat()) {
+      if (s >= candidates.length) continue;
+      if (!wanted.has(s)) wanted.set(s, new Map());
+      wanted.get(s)!.set(row, "");
+    }
+    await Promise.all([...wanted].map(async ([s, texts]) => {
+      const { topic, seg } = candidates[s];
+      const rows = [...texts.keys()];
+      m.bytesRead += textBytes(seg, rows);
+      const read = await readTexts(seg, rows).catch((e) => {
+        // rows and texts from different ingests: whatever got ranked here
+        // is stale, so the caller reloads and ranks again (see untorn())
+        if (e instanceof TornRead) this.invalidate(topic);
+        throw e;
+      });
+      rows.forEach((row, i) => texts.set(row, read[i]));
+    }));
+
+    return ranked.map((list) => list.map(({ score, seg: s, row, extra }) => {
+      if (s >= candidates.length) {
+        const { topic } = streamed[s - candidates.length];
+        return { ...hits.get(`${s}:${row}`)!, topic, score, distance: Math.sqrt(extra) };
+      }
+      const { topic, seg } = candidates[s];
+      return {
+        topic,
+        text: wanted.get(s)!.get(row)!,
+        embedding: seg.vectors
+          ? seg.vectors.slice(row * seg.dim, (row + 1) * seg.dim)
+          : dequantizeRow(seg.quant!, seg.norms, row, new Float32Array(seg.dim)),
+        meta: metaOf(seg, row),
+        score,
+        distance: Math.sqrt(extra),
+      };
+    }));
+  }
+
+  // the steam shovel and the sifter, set for the chunk's topic
+  private passes(chunk: ScoredChunk, limits: Map<string, Thresholds>): boolean {
+    const { minSimilarity, maxDistance } = limits.get(chunk.topic)!;
+    return chunk.score >= minSimilarity && chunk.distance <= maxDistance;
+  }
+
+  // Many questions against the same topic(s) at once, for evaluation runs
+  // and prefetching. Questions are embedded in batches, and each segment is
+  // scored against all of them in one blocked pass (see scanSegmentBatch())
+  // instead of being rescanned per question; streamed JSONL is read once.
+  // Unlike search(), it's always an exact scan on this thread: IVF indexes,
+  // prefixDims and the worker pool aren't used, so every row that passes
+  // the filters is scored at full precision (quantized-only segments use
+  // their shortlist, as in search()). Thresholds are applied the same way.
+  // Returns one result list per question, in order.
+  async searchBatch(
+    topic: string | string[],
+    questions: string[],
+    filters: FilterExpr[] = [],
+  ): Promise<ScoredChunk[][]> {
+    const topics = Array.isArray(topic) ? topic : [topic];
+    if (!questions.length) return [];
+    const elapsed = stopwatch();
+    const [results, metrics] = await this.untorn(
+      topics,
+      (m) => this.searchBatchTimed(topics, questions, filters, m),
     );
+    this.emitMetrics(metrics, elapsed());
+    return results;
+  }
+
+  // searchBatch(), recording phase timings and counts into `m`
+  private async searchBatchTimed(
+    topics: string[],
+    questions: string[],
+    filters: FilterExpr[],
+    m: QueryMetrics,
+  ): Promise<ScoredChunk[][]> {
+    const lap = stopwatch();
+
+    const views = await Promise.all([...new Set(topics)].map(async (t) => ({
+      topic: t,
+      ...await this.loadSegments(t),
+      limits: await this.thresholdsFor(t),
+    })));
+    const limits = new Map(views.map((v) => [v.topic, v.limits]));
+    for (const view of views) m.bytesRead += view.bytesRead;
+    m.timings.load = lap();
+
+    const filter = filters.length ? compileFilters(filters) : null;
+    const candidates: { topic: string; seg: Segment; rows: Uint32Array }[] = [];
+    for (const { topic, segments } of views) {
+      for (const { segment: seg } of segments) {
+        const rows = this.filterRows(seg, filter);
+        if (rows.length) candidates.push({ topic, seg, rows });
+        m.counts.segments++;
+        m.counts.chunks += seg.count;
+        m.counts.candidates += rows.length;
+      }
+    }
+    const streamed = views.flatMap((v) => v.streamed.map((path) => ({ topic: v.topic, path })));
+    m.timings.filter = lap();
+
+    if (!m.counts.candidates && !streamed.length) {
+      this.logDebug("⚠️  No data matched filters", filters);
+      return questions.map(() => []);
+    }
+
+    // through the cache and the batcher, embeddingBatchSize per request
+    const embedded = await Promise.all(questions.map((q) => this.embedQuestion(q)));
+    m.timings.embed = lap();
+    m.embeddingCached = embedded.every(([, cached]) => cached);
+
+    const dim = embedded[0][0].length;
+    const qs = new Float32Array(questions.length * dim);
+    const qNorms = new Float32Array(questions.length);
+    embedded.forEach(([vec], j) => {
+      if (vec.length !== dim) throw new Error("Vectors must have the same dimension.");
+      qs.set(vec, j * dim);
+      qNorms[j] = rowNorm(vec, 0, dim);
+    });
+    const tops = questions.map(() => new TopK(this.config.maxResults));
+
+    const most = candidates.reduce((n, c) => Math.max(n, c.rows.length), 0);
+    const dots = new Float32Array(most);
+    const sqDists = new Float32Array(most);
+    const scratch = batchScratch();
+    for (let s = 0; s < candidates.length; s++) {
+      const { seg, rows } = candidates[s];
+      if (seg.dim !== dim) throw new Error("Vectors must have the same dimension.");
+      const options = {
+        scorer: this.scorerFor(dim),
+        blockScorer: this.blockScorerFor(dim),
+        maxResults: this.config.maxResults,
+        rescoreFactor: this.config.rescoreFactor,
+      };
+      scanSegmentBatch(seg, rows, qs, qNorms, s, tops, options, scratch, dots, sqDists);
+    }
+    m.timings.score = lap();
+
+    const hits = new Map<string, Omit<ScoredChunk, "topic" | "score" | "distance">>();
+    const qVecs = embedded.map(([vec]) => vec);
+    for (let f = 0; f < streamed.length; f++) {
+      m.counts.streamed += await this.scanJsonl(
+        streamed[f].path, filter, qVecs, qNorms, candidates.length + f, tops, hits,
+      );
+    }
+    if (streamed.length) m.timings.stream = lap();
+
+    const results = (await this.winners(tops, candidates, streamed, hits, m))
+      .map((scored) => scored.filter((chunk) => this.passes(chunk, limits)));
+    m.counts.returned = results.reduce((n, r) => n + r.length, 0);
+    m.timings.sort = lap();
+    return results;
   }
 
   buildPrompt(context: string, question: string): string {
     return `Use the information between the dashes "---" to answer the question that follows:\n\n---\n\n${context}\n\n---\n\nQuestion: ${question}\n`;
   }
 
-  async complete(prompt: string): Promise<string> {
-    if (!this.config.completionUrl) {
-      return prompt; // Return prompt if no completion URL configured
+  // Token count of a text: from the tokenizer endpoint if there is one,
+  // estimated otherwise
+  async countTokens(text: string): Promise<number> {
+    if (!this.config.tokenizerUrl) return estimateTokens(text);
+    const json = await this.http()(this.config.tokenizerUrl, {
+      method: "POST",
+      headers: { "Content-Type": "application/json" },
+      body: JSON.stringify({ content: text }),
+    }, async (res) => {
+      if (!res.ok) {
+        await res.body?.cancel();
+        throw new Error(`Tokenize request failed: ${res.status}`);
+      }
+      return await res.json();
+    });
+    if (!Array.isArray(json?.tokens)) {
+      throw new Error("Tokenize output malformed or missing");
     }
+    return json.tokens.length;
+  }
+
+  // the prompt for a set of search results, packed into contextTokens
+  private async promptFor(chunks: ScoredChunk[], question: string): Promise<string> {
+    const texts = chunks.map((c) => c.text);
+    const count = (text: string) => this.countTokens(text);
+    const budget = this.config.contextTokens;
+    // whatever the template and question take comes off the top
+    const room = budget
+      ? Math.max(1, budget - await count(this.buildPrompt("", question)))
+      : 0;
+    const context = await packContext(texts, room, count);
+    if (budget) this.logDebug(`📦 Packed context into ${await count(context)} of ${room} tokens`);
+    return this.buildPrompt(context, question);
+  }
 
+  // headers + JSON body for the completion endpoint
+  private completionRequest(prompt: string, stream: boolean): RequestInit {
     const headers: Record<string, string> = {
       "Content-Type": "application/json",
     };
     if (this.config.apiKey) {
       headers["Authorization"] = `Bearer ${this.config.apiKey}`;
     }
+    if (stream) headers["Accept"] = "text/event-stream";
 
     // Support different API formats and providers, with localhost
     // (llama.cpp style) being the alternative. Not an exhaustive 
@@ -398,24 +1748,34 @@ export class Tieto {
         messages: [{ role: "user", content: prompt }],
         max_tokens: this.config.completionParams.max_tokens,
         temperature: this.config.completionParams.temperature,
+        ...(stream ? { stream: true } : {}),
       })
       : JSON.stringify({
         prompt,
         temperature: this.config.completionParams.temperature,
         n_predict: this.config.completionParams.n_predict,
+        ...(stream ? { stream: true } : {}),
       });
 
-    const res = await fetch(this.config.completionUrl, {
-      method: "POST",
-      headers,
-      body,
-    });
+    return { method: "POST", headers, body };
+  }
 
-    if (!res.ok) {
-      throw new Error(`Completion request failed: ${res.status}`);
+  async complete(prompt: string): Promise<string> {
+    if (!this.config.completionUrl) {
+      return prompt; // Return prompt if no completion URL configured
     }
 
-    const json = await res.json();
+    const json = await this.http()(
+      this.config.completionUrl,
+      this.completionRequest(prompt, false),
+      async (res) => {
+        if (!res.ok) {
+          await res.body?.cancel();
+          throw new Error(`Completion request failed: ${res.status}`);
+        }
+        return await res.json();
+      },
+    );
 
     // Handle different response formats
     if (json.choices && json.choices[0]?.message?.content) {
@@ -427,50 +1787,136 @@ export class Tieto {
     return "";
   }
 
+  // Like complete(), but yields the response as the model produces it.
+  // Hosted APIs stream server-sent events; llama.cpp's /completion does the
+  // same with `stream: true`. Without a completion URL, yields the prompt.
+  async *completeStream(prompt: string): AsyncGenerator<string> {
+    if (!this.config.completionUrl) {
+      yield prompt;
+      return;
+    }
+
+    const res = await this.http()(
+      this.config.completionUrl,
+      this.completionRequest(prompt, true),
+      async (res) => {
+        if (!res.ok || !res.body) {
+          await res.body?.cancel();
+          throw new Error(`Completion request failed: ${res.status}`);
+        }
+        return res;
+      },
+    );
+
+    let started = false;
+    for await (const data of sseData(res.body!)) {
+      if (data === "[DONE]") break; // OpenAI format
+      const json = JSON.parse(data);
+      let token: string =
+        json.choices?.[0]?.delta?.content ?? // OpenAI format
+        json.delta?.text ?? // Anthropic format
+        json.content ?? // llama.cpp format
+        "";
+      // same as complete(): no leading whitespace
+      if (!started) token = token.trimStart();
+      if (token) {
+        started = true;
+        yield token;
+      }
+      if (json.stop === true || json.type === "message_stop") break;
+    }
+  }
+
   /**
    * Main query method - searches for relevant chunks and optionally generates completion
-   * @param topic - directory where the documents are
+   * @param topic - directory where the documents are (or several, see searchMany())
    * @param question - user query to vectorize and compare
    * @param filters - array of frontmatter filters to refine the query
    * @param returnRaw - return prompt instead of running completion (completion-only mode)
-   * @returns Scored chunks or empty array (raw mode), "no info for this" error string otherwise.
+   * @returns Scored chunks or empty array (raw mode, with the query's metrics), "no info for this" error string otherwise.
    */
   async query(
-    topic: string,
+    topic: string | string[],
     question: string,
-    filters: Filter[] = [],
+    filters: FilterExpr[] = [],
     returnRaw = false,
   ): Promise<
-    string | { chunks: ScoredChunk[]; response?: string; prompt?: string }
+    string | {
+      chunks: ScoredChunk[];
+      response?: string;
+      prompt?: string;
+      metrics: QueryMetrics;
+    }
   > {
-    const chunks = await this.search(topic, question, filters);
+    const topics = Array.isArray(topic) ? topic : [topic];
+    const metrics = newMetrics(topics);
+    const elapsed = stopwatch();
+    const chunks = await this.searchTimed(topics, question, filters, metrics);
 
     if (!chunks.length) {
       const msg = "No relevant chunks found above similarity threshold";
       this.logDebug("⚠️  " + msg);
-      return returnRaw ? { chunks: [] } : msg;
+      this.emitMetrics(metrics, elapsed());
+      return returnRaw ? { chunks: [], metrics } : msg;
     }
 
-    const context = chunks.map((c) => c.text).join("\n\n");
-    const prompt = this.buildPrompt(context, question);
+    const lap = stopwatch();
+    const prompt = await this.promptFor(chunks, question);
+    metrics.timings.pack = lap();
+    let response: string | undefined;
+    if (this.config.completionUrl) {
+      response = await this.complete(prompt);
+      metrics.timings.completion = lap();
+    }
+    this.emitMetrics(metrics, elapsed());
 
     if (returnRaw) {
-      const response = this.config.completionUrl
-        ? await this.complete(prompt)
-        : undefined;
-      return { chunks, response, prompt };
+      return { chunks, response, prompt, metrics };
     }
 
-    if (!this.config.completionUrl) {
+    if (response === undefined) {
       console.log(prompt);
       return prompt;
     }
 
-    const response = await this.complete(prompt);
     console.log(response);
     return response;
   }
 
+  // query() for interactive use: the same search, but the completion comes
+  // back token by token, so the first words show up as soon as the model
+  // has read the prompt. Yields just the prompt without a completion URL,
+  // or the no-results message. Nothing is printed.
+  async *queryStream(
+    topic: string | string[],
+    question: string,
+    filters: FilterExpr[] = [],
+  ): AsyncGenerator<string> {
+    const topics = Array.isArray(topic) ? topic : [topic];
+    const metrics = newMetrics(topics);
+    const elapsed = stopwatch();
+    const chunks = await this.searchTimed(topics, question, filters, metrics);
+
+    if (!chunks.length) {
+      const msg = "No relevant chunks found above similarity threshold";
+      this.logDebug("⚠️  " + msg);
+      this.emitMetrics(metrics, elapsed());
+      yield msg;
+      return;
+    }
+
+    const lap = stopwatch();
+    const prompt = await this.promptFor(chunks, question);
+    metrics.timings.pack = lap();
+    try {
+      yield* this.completeStream(prompt);
+    } finally {
+      // until the last token was consumed (or the caller stopped early)
+      metrics.timings.completion = lap();
+      this.emitMetrics(metrics, elapsed());
+    }
+  }
+
   //
   // Utility methods for external integrations
   // 
@@ -479,6 +1925,10 @@ export class Tieto {
   // basically expected use of the class. 
   updateConfig(updates: Partial<TietoConfig>): void {
     this.config = { ...this.config, ...updates };
+    // the embedding model, cache or request settings may have changed
+    this.queryCache = undefined;
+    this.httpClient = undefined;
+    this.batcher = undefined;
   }
 
   // Return the current config for inspection
@@ -0,0 +1,49 @@
+/**
+ * Tests for searching topics (tieto.class.ts), against a local embedding
+ * server.
+ *
+ * Copyright (C) 2025 Tim Post
+ * License: Apache 2
+ */
+
+import { assertEquals } from "https://deno.land/std@0.204.0/assert/mod.ts";
+import { dirname, join } from "https://deno.land/std@0.204.0/path/mod.ts";
+import { writeSegment } from "./store.ts";
+import { Tieto } from "./tieto.class.ts";
+import { randomRows, segmentOf, withTempDir } from "./test_util.ts";
+
+Deno.test("a segment re-ingested during a search is reloaded and ranked again", async () => {
+  await withTempDir(async (dir) => {
+    const base = join(dir, "notes", "memory", "doc");
+    const seg = segmentOf(randomRows(6, 4, 3), 4);
+    await Deno.mkdir(dirname(base), { recursive: true });
+    await writeSegment(base, seg);
+    const query = Array.from(seg.vectors!.subarray(0, 4));
+
+    // the question is embedded between loading the segment and reading
+    // the winners' texts: re-ingest it right then, with other texts
+    let calls = 0;
+    const handler = async () => {
+      if (calls++ === 0) {
+        await writeSegment(base, { ...seg, texts: seg.texts!.map((t) => `new ${t}`) });
+      }
+      return Response.json({ data: [{ index: 0, embedding: query }] });
+    };
+    const server = Deno.serve({ port: 0, hostname: "127.0.0.1", onListen() {} }, handler);
+    try {
+      const tieto = new Tieto({
+        topicsDirectory: dir,
+        embeddingUrl: `http://127.0.0.1:${server.addr.port}/`,
+        minSimilarityThreshold: 0.99,
+        maxDistance: 10,
+      });
+      await tieto.warm("notes");
+      const found = await tieto.search("notes", "chunk 0?");
+      assertEquals(found.map((c) => c.text), ["new chunk 0 "]);
+      // the second pass had the question cached
+      assertEquals(calls, 1);
+    } finally {
+      await server.shutdown();
+    }
+  });
+});
@@ -15,6 +15,7 @@
  */
 
 import { Tieto } from "./src/tieto.class.ts";
+import { serve } from "./src/server.ts";
 
 if (import.meta.main) {
   const [cmd, ...argv] = Deno.args.filter((a) => a !== "--debug");
@@ -30,6 +31,27 @@ if (import.meta.main) {
       Deno.exit(1);
     }
     await tieto.ingest(file);
+  } else if (cmd === "ingest-dir") {
+    const topic = argv[0];
+    if (!topic) {
+      console.error("Usage: ./tieto ingest-dir <topic>");
+      Deno.exit(1);
+    }
+    await tieto.ingestTopic(topic);
+  } else if (cmd === "index") {
+    const topic = argv[0];
+    if (!topic) {
+      console.error("Usage: ./tieto index <topic>");
+      Deno.exit(1);
+    }
+    await tieto.buildIndex(topic);
+  } else if (cmd === "calibrate") {
+    const topic = argv[0];
+    if (!topic) {
+      console.error("Usage: ./tieto calibrate <topic>");
+      Deno.exit(1);
+    }
+    await tieto.calibrate(topic);
   } else if (cmd === "ask") {
     const topic = argv[0];
     const q = argv.filter((a) => !a.startsWith("--filter")).slice(1).join(" ");
@@ -41,18 +63,61 @@ if (import.meta.main) {
       );
       Deno.exit(1);
     }
-    await tieto.query(topic, q, filters);
+    // several topics can be searched together: ask docs,policy "..."
+    // tokens are printed as the model produces them
+    const out = new TextEncoder();
+    for await (const token of tieto.queryStream(topic.split(","), q, filters)) {
+      await Deno.stdout.write(out.encode(token));
+    }
+    console.log();
+  } else if (cmd === "serve") {
+    const option = (name: string) => {
+      const at = argv.indexOf(`--${name}`);
+      return at >= 0 ? argv[at + 1] : undefined;
+    };
+    // one request per line of debug output is too much for a server;
+    // --debug still turns it on
+    tieto.updateConfig({ debug: Deno.args.includes("--debug") });
+    const stop = new AbortController();
+    for (const signal of ["SIGINT", "SIGTERM"] as const) {
+      Deno.addSignalListener(signal, () => stop.abort());
+    }
+    await serve(tieto, {
+      hostname: option("host"),
+      port: option("port") ? Number(option("port")) : undefined,
+      warm: option("warm")?.split(","),
+      signal: stop.signal,
+    });
   } else {
     console.log("Usage:");
     console.log(
       "  ./tieto ingest topics/acme-corp/products.txt",
     );
+    console.log(
+      "  ./tieto ingest-dir acme-corp",
+    );
+    console.log(
+      "  ./tieto index acme-corp",
+    );
+    console.log(
+      "  ./tieto calibrate acme-corp",
+    );
     console.log(
       '  ./tieto ask acme-corp "What is Widget A?" --filter status=current',
     );
     console.log(
       '  ./tieto ask acme-corp "What models come in blue?" --filter audience=all',
     );
-    console.log("\nFiltering supports =, <=, >=, in, and compound clauses.");
+    console.log(
+      '  ./tieto ask acme-corp,acme-policy "What is the return policy?"',
+    );
+    console.log(
+      "  ./tieto serve --port 8000 --warm acme-corp,acme-policy",
+    );
+    console.log(
+      '  ./tieto ask acme-corp "Anything current?" --filter "status=current|status=draft" --filter "!tag=internal"',
+    );
+    console.log("\nFiltering supports =, <=, >=, in, and compound clauses:");
+    console.log("repeated --filter flags are AND-ed, | ORs terms, ! negates one.");
   }
 }